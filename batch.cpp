@@ -0,0 +1,129 @@
+#include "batch.h"
+
+#include "bytecode.h"
+#include "cell.h"
+#include "fusion.h"
+#include "parallel.h"
+#include "propagate.h"
+#include "vm.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+std::vector<Job> read_manifest(const char* manifest) {
+	std::ifstream file(manifest);
+	
+	if(!file) {
+		throw std::runtime_error(std::string("cannot open ") + manifest);
+	}
+	
+	std::vector<Job> jobs;
+	std::string line;
+	
+	for(int number = 1; std::getline(file, line); number++) {
+		std::istringstream fields(line);
+		Job job;
+		std::string rest;
+		
+		if(!(fields >> job.image) || job.image[0] == '#') continue;
+		
+		if(!(fields >> job.input >> job.output) || fields >> rest) {
+			throw std::runtime_error(std::string(manifest) + " line " + std::to_string(number) + " is not an image, input and output");
+		}
+		
+		jobs.push_back(job);
+	}
+	
+	return jobs;
+}
+
+// Runs one job on the bytecode of its image, reading and writing through buffered files of its own. An input of - is never opened, and a stream that is not open reads like one that has ended
+template<typename Cell>
+Outcome run_job(const Job& job, const Bytecode& bytecode) {
+	std::ifstream in;
+	
+	if(job.input != "-") {
+		in.open(job.input, std::ios::binary);
+		
+		if(!in) return {1, 0, "cannot open " + job.input};
+	}
+	
+	std::ofstream out(job.output, std::ios::binary);
+	
+	if(!out) return {1, 0, "cannot open " + job.output};
+	
+	Outcome outcome = {0, 0, ""};
+	
+	VM<Cell> vm;
+	vm.in = &in;
+	vm.out = &out;
+	
+	try {
+		run(bytecode, vm);
+	} catch(const Overflow& overflow) {
+		// Whatever was written before is kept, like it is on a terminal
+		outcome = {2, 0, std::string(overflow.what()) + " in block " + std::to_string(vm.block)};
+	}
+	
+	outcome.steps = vm.steps;
+	out.close();
+	
+	if(!out) return {1, vm.steps, "cannot write " + job.output};
+	
+	return outcome;
+}
+
+template<typename Cell>
+std::vector<Outcome> run_batch(const std::vector<Job>& jobs, const std::function<Program(const char*)>& load, unsigned threads) {
+	// Every distinct image, in the order jobs first mention them
+	std::map<std::string, std::size_t> indices;
+	std::vector<std::string> images;
+	std::vector<std::size_t> image_of(jobs.size());
+	
+	for(std::size_t i = 0; i < jobs.size(); i++) {
+		const auto inserted = indices.emplace(jobs[i].image, images.size());
+		
+		if(inserted.second) {
+			images.push_back(jobs[i].image);
+		}
+		
+		image_of[i] = inserted.first->second;
+	}
+	
+	// Loading and compiling an image takes far longer than handing out the next one, so the images are shared out the same way as the jobs
+	std::vector<Bytecode> compiled(images.size(), Bytecode({}, {}, {}));
+	std::vector<std::string> errors(images.size());
+	std::atomic<std::size_t> next(0);
+	
+	parallel(std::min<std::size_t>(threads, images.size()), [&](unsigned) {
+		for(std::size_t i = next++; i < images.size(); i = next++) {
+			try {
+				compiled[i] = propagate(fuse(compile(load(images[i].c_str()))));
+			} catch(const std::runtime_error& error) {
+				errors[i] = error.what();
+			}
+		}
+	});
+	
+	std::vector<Outcome> outcomes(jobs.size());
+	
+	next = 0;
+	
+	parallel(std::min<std::size_t>(threads, jobs.size()), [&](unsigned) {
+		for(std::size_t i = next++; i < jobs.size(); i = next++) {
+			const std::size_t image = image_of[i];
+			
+			outcomes[i] = errors[image].empty() ? run_job<Cell>(jobs[i], compiled[image]) : Outcome{1, 0, errors[image]};
+		}
+	});
+	
+	return outcomes;
+}
+
+// Only checked cells count steps
+template std::vector<Outcome> run_batch<Checked<std::int32_t>>(const std::vector<Job>& jobs, const std::function<Program(const char*)>& load, unsigned threads);
+template std::vector<Outcome> run_batch<Checked<std::int64_t>>(const std::vector<Job>& jobs, const std::function<Program(const char*)>& load, unsigned threads);
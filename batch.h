@@ -0,0 +1,32 @@
+#ifndef PIET_BATCH_H
+#define PIET_BATCH_H
+
+#include "program.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// One line of a manifest: the image to run, the file its input is read from, - for none, and the file its output is written to
+struct Job {
+	std::string image;
+	std::string input;
+	std::string output;
+};
+
+// What became of a job. Status is what piet would have exited with: 0 when the program ended, 1 when something could not be read or written and 2 on overflow
+struct Outcome {
+	int status;
+	std::uint64_t steps;    // Commands executed, counted like the graph engine counts them, however the bytecode fused them
+	std::string error;      // Why the status is not 0
+};
+
+// Reads one job per line, given as three paths separated by whitespace. Blank lines and lines starting with # are skipped. Throws std::runtime_error if the manifest cannot be read or a line is not a job
+std::vector<Job> read_manifest(const char* manifest);
+
+// Runs every job with up to the given number of threads, which take the next job whenever they finish one, so long jobs do not hold up the rest. Every distinct image is loaded and compiled once by load, and all of its jobs share the result. Every job reads and writes through buffered files of its own. Cell has to be a checked cell, since those are what count steps
+template<typename Cell>
+std::vector<Outcome> run_batch(const std::vector<Job>& jobs, const std::function<Program(const char*)>& load, unsigned threads);
+
+#endif //PIET_BATCH_H
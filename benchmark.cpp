@@ -0,0 +1,203 @@
+#include "big.h"
+#include "bytecode.h"
+#include "cell.h"
+#include "classify.h"
+#include "expanded.h"
+#include "fusion.h"
+#include "jit.h"
+#include "program.h"
+#include "propagate.h"
+#include "vm.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Every iteration of the countdown loop executes this many commands: push, subtract, duplicate, not and pointer
+const unsigned LOOP_STEPS = 5;
+
+// A countdown loop built directly as a block graph, so the timings do not depend on any image. The counter is expected on the stack, block 0 pushes 1 and the ring subtracts it, until not turns the pointer towards the halting block 5
+Program countdown() {
+	const Opcode ring[] = {PUSH, SUBTRACT, DUPLICATE, NOT, POINTER};
+	
+	std::vector<std::uint32_t> successors(6 * 8);
+	std::vector<Opcode> opcodes(6 * 8);
+	
+	for(unsigned block = 0; block < 5; block++) {
+		for(unsigned exit = 0; exit < 8; exit++) {
+			successors[block * 8 + exit] = (block + 1) % 5;
+			opcodes[block * 8 + exit] = ring[block];
+		}
+	}
+	
+	// Only dp right continues the loop, the pointer turns it down once the counter reaches zero
+	for(unsigned exit = 2; exit < 8; exit++) {
+		successors[exit] = 5;
+		opcodes[exit] = SKIP;
+	}
+	
+	for(unsigned exit = 0; exit < 8; exit++) {
+		successors[5 * 8 + exit] = 5;
+		opcodes[5 * 8 + exit] = BLOCKED;
+	}
+	
+	return Program(successors, opcodes, std::vector<std::uint32_t>(6, 1), std::vector<unsigned char>(6, 0));
+}
+
+template<typename Cell, typename Engine>
+void measure(const char* engine, const char* cell, std::uint32_t iterations, Engine engine_run) {
+	VM<Cell> vm;
+	vm.stack.push(Cell(iterations));
+	
+	const auto start = std::chrono::steady_clock::now();
+	engine_run(vm);
+	const auto end = std::chrono::steady_clock::now();
+	
+	const double nanoseconds = std::chrono::duration<double, std::nano>(end - start).count();
+	
+	std::cout << std::left << std::setw(18) << engine << std::setw(16) << cell << std::right << std::fixed << std::setprecision(2) << std::setw(10) << nanoseconds / (static_cast<double>(iterations) * LOOP_STEPS) << " ns/step" << std::endl;
+}
+
+template<typename Cell>
+void measure_all(const Program& program, const Expanded& expanded, const Bytecode& bytecode, const char* cell, std::uint32_t iterations) {
+	measure<Cell>("graph", cell, iterations, [&](VM<Cell>& vm) { run(program, vm); });
+	measure<Cell>("expanded", cell, iterations, [&](VM<Cell>& vm) { run(expanded, vm); });
+	measure<Cell>("bytecode call", cell, iterations, [&](VM<Cell>& vm) { run(bytecode, vm, CALL_DISPATCH); });
+	measure<Cell>("bytecode switch", cell, iterations, [&](VM<Cell>& vm) { run(bytecode, vm, SWITCH_DISPATCH); });
+	measure<Cell>("bytecode threaded", cell, iterations, [&](VM<Cell>& vm) { run(bytecode, vm, THREADED_DISPATCH); });
+}
+
+// Writes a side x side bitmap of randomly sized rectangles in all twenty colors, which gives blocks of every shape and plenty of white codels. Returns false if the file cannot be written
+bool write_image(const char* filename, int side) {
+	const unsigned char palette[20][3] = {
+			{0xC0, 0xC0, 0xFF}, {0xC0, 0xFF, 0xFF}, {0xC0, 0xFF, 0xC0}, {0xFF, 0xFF, 0xC0}, {0xFF, 0xC0, 0xC0}, {0xFF, 0xC0, 0xFF},
+			{0x00, 0x00, 0xFF}, {0x00, 0xFF, 0xFF}, {0x00, 0xFF, 0x00}, {0xFF, 0xFF, 0x00}, {0xFF, 0x00, 0x00}, {0xFF, 0x00, 0xFF},
+			{0x00, 0x00, 0xC0}, {0x00, 0xC0, 0xC0}, {0x00, 0xC0, 0x00}, {0xC0, 0xC0, 0x00}, {0xC0, 0x00, 0x00}, {0xC0, 0x00, 0xC0},
+			{0xFF, 0xFF, 0xFF}, {0x00, 0x00, 0x00}
+	};
+	
+	std::vector<unsigned char> pixels(3 * side * side);
+	std::mt19937 random(42);
+	
+	for(int y = 0; y < side; y += 1 + random() % 64) {
+		for(int x = 0; x < side; x += 1 + random() % 64) {
+			const int w = 1 + random() % 64;
+			const int h = 1 + random() % 64;
+			const unsigned char* color = palette[random() % 20];
+			
+			for(int j = y; j < std::min(side, y + h); j++) {
+				for(int i = x; i < std::min(side, x + w); i++) {
+					std::copy(color, color + 3, &pixels[3 * (j * side + i)]);
+				}
+			}
+		}
+	}
+	
+	unsigned char header[54] = {'B', 'M'};
+	header[10] = 54;
+	header[14] = 40;
+	header[26] = 1;
+	header[28] = 24;
+	
+	for(int i = 0; i < 4; i++) {
+		header[18 + i] = side >> 8 * i;
+		header[22 + i] = side >> 8 * i;
+	}
+	
+	FILE* file = std::fopen(filename, "wb");
+	
+	if(!file) return false;
+	
+	const bool written = std::fwrite(header, 1, sizeof(header), file) == sizeof(header) && std::fwrite(pixels.data(), 1, pixels.size(), file) == pixels.size();
+	
+	return std::fclose(file) == 0 && written;
+}
+
+// Times every classifier this processor supports on the same random pixels, which hit all 27 combinations of channel classes in no particular order
+void measure_classifying(int side) {
+	const std::size_t count = static_cast<std::size_t>(side) * side;
+	const char* names[] = {"scalar", "ssse3", "avx2"};
+	
+	std::vector<unsigned char> pixels(3 * count);
+	std::vector<unsigned char> colors(count);
+	std::mt19937 random(42);
+	
+	for(unsigned char& channel : pixels) {
+		channel = random();
+	}
+	
+	for(const Classifier classifier : {SCALAR_CLASSIFIER, SSSE3_CLASSIFIER, AVX2_CLASSIFIER}) {
+		if(!supported(classifier)) continue;
+		
+		const auto start = std::chrono::steady_clock::now();
+		classify(pixels.data(), count, colors.data(), classifier);
+		const auto end = std::chrono::steady_clock::now();
+		
+		const double seconds = std::chrono::duration<double>(end - start).count();
+		
+		std::cout << std::left << std::setw(18) << "classify" << std::setw(16) << names[classifier] << std::right << std::fixed << std::setprecision(1) << std::setw(10) << count / seconds / 1e6 << " Mpixels/s" << std::endl;
+	}
+}
+
+// Times loading the same image with more and more threads, going up to at least 4 so the tiled labeler is measured even on small machines
+void measure_loading(int side) {
+	const char* filename = "benchmark.bmp";
+	
+	if(!write_image(filename, side)) {
+		std::remove(filename);
+		std::cerr << "cannot write " << filename << ", skipping loading" << std::endl;
+		return;
+	}
+	
+	double single = 0;
+	
+	for(unsigned threads = 1; threads <= std::max(4u, std::thread::hardware_concurrency()); threads *= 2) {
+		const auto start = std::chrono::steady_clock::now();
+		const Program program = load_image(filename, 1, threads);
+		const auto end = std::chrono::steady_clock::now();
+		
+		const double milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+		
+		if(threads == 1) {
+			single = milliseconds;
+		}
+		
+		std::cout << "load " << side << "x" << side << std::setw(4) << threads << " threads" << std::fixed << std::setprecision(1) << std::setw(10) << milliseconds << " ms" << std::setprecision(2) << std::setw(8) << single / milliseconds << "x, " << program.block_count() << " blocks" << std::endl;
+	}
+	
+	std::remove(filename);
+}
+
+// Times the engines on the same loop with every cell type, the difference between a cell and its checked variant is the cost of overflow detection when nothing overflows. Then times classifying pixels and loading a generated image with 1, 2, 4, ... threads
+int main(int argc, char** argv) {
+	const std::uint32_t iterations = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000000;
+	const int side = argc > 2 ? std::atoi(argv[2]) : 4096;
+	
+	if(iterations == 0 || side < 1) {
+		std::cerr << "usage: benchmark [iterations] [image side]" << std::endl;
+		return 1;
+	}
+	
+	const Program program = countdown();
+	const Expanded expanded(program);
+	const Bytecode bytecode = propagate(fuse(compile(program)));
+	
+	measure<std::int32_t>("jit", "int32", iterations, [&](VM<std::int32_t>& vm) { run_jit(bytecode, vm); });
+	measure_all<std::int32_t>(program, expanded, bytecode, "int32", iterations);
+	measure_all<Checked<std::int32_t>>(program, expanded, bytecode, "checked int32", iterations);
+	measure_all<std::int64_t>(program, expanded, bytecode, "int64", iterations);
+	measure_all<Checked<std::int64_t>>(program, expanded, bytecode, "checked int64", iterations);
+	measure_all<Big>(program, expanded, bytecode, "big", iterations);
+	
+	measure_classifying(side);
+	measure_loading(side);
+	
+	return 0;
+}
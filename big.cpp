@@ -0,0 +1,321 @@
+#include "big.h"
+
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include <utility>
+
+typedef std::vector<std::uint32_t> Limbs;
+
+void trim(Limbs& limbs) {
+	while(!limbs.empty() && limbs.back() == 0) {
+		limbs.pop_back();
+	}
+}
+
+int compare_magnitude(const Limbs& a, const Limbs& b) {
+	if(a.size() != b.size()) return a.size() < b.size() ? -1 : 1;
+	
+	for(std::size_t i = a.size(); i-- > 0;) {
+		if(a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+	}
+	
+	return 0;
+}
+
+Limbs add_magnitude(const Limbs& a, const Limbs& b) {
+	Limbs sum(std::max(a.size(), b.size()) + 1);
+	std::uint64_t carry = 0;
+	
+	for(std::size_t i = 0; i < sum.size(); i++) {
+		carry += (i < a.size() ? a[i] : 0) + static_cast<std::uint64_t>(i < b.size() ? b[i] : 0);
+		sum[i] = carry;
+		carry >>= 32;
+	}
+	
+	trim(sum);
+	
+	return sum;
+}
+
+// Requires a >= b
+Limbs subtract_magnitude(const Limbs& a, const Limbs& b) {
+	Limbs difference(a.size());
+	std::int64_t borrow = 0;
+	
+	for(std::size_t i = 0; i < a.size(); i++) {
+		std::int64_t limb = static_cast<std::int64_t>(a[i]) - (i < b.size() ? b[i] : 0) - borrow;
+		
+		borrow = limb < 0;
+		difference[i] = limb + (borrow << 32);
+	}
+	
+	trim(difference);
+	
+	return difference;
+}
+
+Limbs multiply_magnitude(const Limbs& a, const Limbs& b) {
+	Limbs product(a.size() + b.size());
+	
+	for(std::size_t i = 0; i < a.size(); i++) {
+		std::uint64_t carry = 0;
+		
+		for(std::size_t j = 0; j < b.size(); j++) {
+			carry += static_cast<std::uint64_t>(a[i]) * b[j] + product[i + j];
+			product[i + j] = carry;
+			carry >>= 32;
+		}
+		
+		product[i + b.size()] = carry;
+	}
+	
+	trim(product);
+	
+	return product;
+}
+
+// Divides in place by a single limb and returns the remainder
+std::uint32_t divide_limb(Limbs& a, std::uint32_t divisor) {
+	std::uint64_t remainder = 0;
+	
+	for(std::size_t i = a.size(); i-- > 0;) {
+		remainder = remainder << 32 | a[i];
+		a[i] = remainder / divisor;
+		remainder %= divisor;
+	}
+	
+	trim(a);
+	
+	return remainder;
+}
+
+// Long division, Knuth's algorithm D. Requires b to be non-zero
+void divide_magnitude(const Limbs& a, const Limbs& b, Limbs& quotient, Limbs& remainder) {
+	if(compare_magnitude(a, b) < 0) {
+		quotient.clear();
+		remainder = a;
+		return;
+	}
+	
+	if(b.size() == 1) {
+		quotient = a;
+		remainder = {divide_limb(quotient, b[0])};
+		trim(remainder);
+		return;
+	}
+	
+	// Shift both so the top limb of the divisor has its high bit set, which keeps the quotient estimates off by at most 2
+	const int shift = __builtin_clz(b.back());
+	const std::size_t n = b.size();
+	const std::size_t m = a.size() - n;
+	
+	Limbs u(a.size() + 1);
+	Limbs v(n);
+	
+	for(std::size_t i = n; i-- > 0;) {
+		v[i] = b[i] << shift | (shift && i ? b[i - 1] >> (32 - shift) : 0);
+	}
+	
+	u[a.size()] = shift ? a.back() >> (32 - shift) : 0;
+	
+	for(std::size_t i = a.size(); i-- > 0;) {
+		u[i] = a[i] << shift | (shift && i ? a[i - 1] >> (32 - shift) : 0);
+	}
+	
+	quotient.assign(m + 1, 0);
+	
+	for(std::size_t j = m + 1; j-- > 0;) {
+		const std::uint64_t top = static_cast<std::uint64_t>(u[j + n]) << 32 | u[j + n - 1];
+		std::uint64_t estimate = top / v[n - 1];
+		std::uint64_t rest = top % v[n - 1];
+		
+		while(estimate >> 32 || estimate * v[n - 2] > (rest << 32 | u[j + n - 2])) {
+			estimate--;
+			rest += v[n - 1];
+			
+			if(rest >> 32) break;
+		}
+		
+		// Multiply and subtract, adding back if the estimate was still one too large
+		std::int64_t borrow = 0;
+		std::uint64_t carry = 0;
+		
+		for(std::size_t i = 0; i < n; i++) {
+			carry += estimate * v[i];
+			
+			const std::int64_t limb = static_cast<std::int64_t>(u[i + j]) - static_cast<std::uint32_t>(carry) - borrow;
+			
+			carry >>= 32;
+			borrow = limb < 0;
+			u[i + j] = limb + (borrow << 32);
+		}
+		
+		const std::int64_t limb = static_cast<std::int64_t>(u[j + n]) - static_cast<std::int64_t>(carry) - borrow;
+		
+		u[j + n] = limb;
+		
+		if(limb < 0) {
+			estimate--;
+			carry = 0;
+			
+			for(std::size_t i = 0; i < n; i++) {
+				carry += static_cast<std::uint64_t>(u[i + j]) + v[i];
+				u[i + j] = carry;
+				carry >>= 32;
+			}
+			
+			u[j + n] += carry;
+		}
+		
+		quotient[j] = estimate;
+	}
+	
+	trim(quotient);
+	
+	remainder.resize(n);
+	
+	for(std::size_t i = 0; i < n; i++) {
+		remainder[i] = u[i] >> shift | (shift ? static_cast<std::uint32_t>(static_cast<std::uint64_t>(u[i + 1]) << (32 - shift)) : 0);
+	}
+	
+	trim(remainder);
+}
+
+Big Big::make(bool negative, std::vector<std::uint32_t> limbs) {
+	trim(limbs);
+	
+	if(limbs.size() <= 2) {
+		std::uint64_t value = 0;
+		
+		for(std::size_t i = limbs.size(); i-- > 0;) {
+			value = value << 32 | limbs[i];
+		}
+		
+		if(!negative && value <= INT64_MAX) return static_cast<std::int64_t>(value);
+		if(negative && value <= static_cast<std::uint64_t>(INT64_MAX) + 1) return static_cast<std::int64_t>(0 - value);
+	}
+	
+	Big big;
+	
+	big.large.reset(new Large{negative, std::move(limbs)});
+	
+	return big;
+}
+
+bool Big::negative(const Big& value) {
+	return value.large ? value.large->negative : value.small < 0;
+}
+
+std::vector<std::uint32_t> Big::magnitude(const Big& value) {
+	if(value.large) return value.large->limbs;
+	
+	const std::uint64_t absolute = value.small < 0 ? 0 - static_cast<std::uint64_t>(value.small) : value.small;
+	Limbs limbs = {static_cast<std::uint32_t>(absolute), static_cast<std::uint32_t>(absolute >> 32)};
+	
+	trim(limbs);
+	
+	return limbs;
+}
+
+Big Big::add(const Big& a, const Big& b, bool subtract) {
+	const bool a_negative = negative(a);
+	const bool b_negative = negative(b) != subtract;
+	const Limbs x = magnitude(a);
+	const Limbs y = magnitude(b);
+	
+	if(a_negative == b_negative) return make(a_negative, add_magnitude(x, y));
+	
+	if(compare_magnitude(x, y) >= 0) return make(a_negative, subtract_magnitude(x, y));
+	
+	return make(b_negative, subtract_magnitude(y, x));
+}
+
+Big Big::multiply(const Big& a, const Big& b) {
+	return make(negative(a) != negative(b), multiply_magnitude(magnitude(a), magnitude(b)));
+}
+
+void Big::divide(const Big& a, const Big& b, Big* quotient, Big* remainder) {
+	Limbs q;
+	Limbs r;
+	
+	divide_magnitude(magnitude(a), magnitude(b), q, r);
+	
+	if(quotient) {
+		*quotient = make(negative(a) != negative(b), std::move(q));
+	}
+	
+	if(remainder) {
+		*remainder = make(negative(a), std::move(r));
+	}
+}
+
+int Big::compare(const Big& a, const Big& b) {
+	const bool a_negative = negative(a);
+	
+	if(a_negative != negative(b)) return a_negative ? -1 : 1;
+	
+	const int magnitudes = compare_magnitude(magnitude(a), magnitude(b));
+	
+	return a_negative ? -magnitudes : magnitudes;
+}
+
+Big::operator std::int64_t() const {
+	if(!large) return small;
+	
+	std::uint64_t value = large->limbs[0] | static_cast<std::uint64_t>(large->limbs[1]) << 32;
+	
+	return large->negative ? 0 - value : value;
+}
+
+std::ostream& operator<<(std::ostream& out, const Big& value) {
+	if(!value.large) return out << value.small;
+	
+	// Nine decimal digits at a time, least significant first
+	Limbs limbs = value.large->limbs;
+	std::vector<std::uint32_t> chunks;
+	
+	while(!limbs.empty()) {
+		chunks.push_back(divide_limb(limbs, 1000000000));
+	}
+	
+	std::string digits = value.large->negative ? "-" : "";
+	
+	digits += std::to_string(chunks.back());
+	
+	for(std::size_t i = chunks.size() - 1; i-- > 0;) {
+		const std::string chunk = std::to_string(chunks[i]);
+		
+		digits += std::string(9 - chunk.size(), '0') + chunk;
+	}
+	
+	return out << digits;
+}
+
+std::istream& operator>>(std::istream& in, Big& value) {
+	std::istream::sentry sentry(in);
+	
+	if(!sentry) return in;
+	
+	bool negative = false;
+	
+	if(in.peek() == '-' || in.peek() == '+') {
+		negative = in.get() == '-';
+	}
+	
+	if(!std::isdigit(in.peek())) {
+		value = 0;
+		in.setstate(std::ios::failbit);
+		return in;
+	}
+	
+	Big result;
+	
+	while(std::isdigit(in.peek())) {
+		result = result * 10 + (in.get() - '0');
+	}
+	
+	value = negative ? 0 - result : result;
+	
+	return in;
+}
@@ -0,0 +1,132 @@
+#ifndef PIET_BIG_H
+#define PIET_BIG_H
+
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+// An integer of any size. Values that fit in 64 bits live inline and only go through the fast paths, anything larger spills to limbs on the heap
+class Big {
+public:
+	Big(std::int64_t value = 0) : small(value) {}
+	
+	Big(const Big& other) : small(other.small), large(other.large ? new Large(*other.large) : nullptr) {}
+	
+	Big(Big&& other) noexcept = default;
+	
+	Big& operator=(const Big& other) {
+		small = other.small;
+		large.reset(other.large ? new Large(*other.large) : nullptr);
+		
+		return *this;
+	}
+	
+	Big& operator=(Big&& other) noexcept = default;
+	
+	// The lowest 64 bits in two's complement
+	explicit operator std::int64_t() const;
+	
+	bool operator!() const {
+		return !large && small == 0;
+	}
+	
+	friend Big operator+(const Big& a, const Big& b) {
+		std::int64_t result;
+		
+		if(!a.large && !b.large && !__builtin_add_overflow(a.small, b.small, &result)) return result;
+		
+		return add(a, b, false);
+	}
+	
+	friend Big operator-(const Big& a, const Big& b) {
+		std::int64_t result;
+		
+		if(!a.large && !b.large && !__builtin_sub_overflow(a.small, b.small, &result)) return result;
+		
+		return add(a, b, true);
+	}
+	
+	friend Big operator*(const Big& a, const Big& b) {
+		std::int64_t result;
+		
+		if(!a.large && !b.large && !__builtin_mul_overflow(a.small, b.small, &result)) return result;
+		
+		return multiply(a, b);
+	}
+	
+	// Truncates like the built in division. Dividing by zero is as undefined as it is for int
+	friend Big operator/(const Big& a, const Big& b) {
+		if(!a.large && !b.large && !(a.small == INT64_MIN && b.small == -1)) return a.small / b.small;
+		
+		Big quotient;
+		
+		divide(a, b, &quotient, nullptr);
+		
+		return quotient;
+	}
+	
+	// Takes the sign of a, like the built in remainder
+	friend Big operator%(const Big& a, const Big& b) {
+		if(!a.large && !b.large) return b.small == -1 ? 0 : a.small % b.small;
+		
+		Big remainder;
+		
+		divide(a, b, nullptr, &remainder);
+		
+		return remainder;
+	}
+	
+	Big& operator+=(const Big& other) {
+		return *this = *this + other;
+	}
+	
+	Big& operator-=(const Big& other) {
+		return *this = *this - other;
+	}
+	
+	Big& operator*=(const Big& other) {
+		return *this = *this * other;
+	}
+	
+	friend bool operator==(const Big& a, const Big& b) {
+		if(!a.large && !b.large) return a.small == b.small;
+		
+		return compare(a, b) == 0;
+	}
+	
+	friend bool operator<(const Big& a, const Big& b) {
+		if(!a.large && !b.large) return a.small < b.small;
+		
+		return compare(a, b) < 0;
+	}
+	
+	friend bool operator>(const Big& a, const Big& b) {
+		return b < a;
+	}
+	
+	friend std::ostream& operator<<(std::ostream& out, const Big& value);
+	friend std::istream& operator>>(std::istream& in, Big& value);
+
+private:
+	// Sign and magnitude, least significant limb first, never fits in 64 bits
+	struct Large {
+		bool negative;
+		std::vector<std::uint32_t> limbs;
+	};
+	
+	std::int64_t small;    // The value, unless large is set
+	std::unique_ptr<Large> large;
+	
+	static Big make(bool negative, std::vector<std::uint32_t> limbs);
+	static bool negative(const Big& value);
+	static std::vector<std::uint32_t> magnitude(const Big& value);
+	
+	static Big add(const Big& a, const Big& b, bool subtract);
+	static Big multiply(const Big& a, const Big& b);
+	static void divide(const Big& a, const Big& b, Big* quotient, Big* remainder);
+	static int compare(const Big& a, const Big& b);
+};
+
+#endif //PIET_BIG_H
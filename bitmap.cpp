@@ -0,0 +1,117 @@
+#include "bitmap.h"
+
+#include "classify.h"
+#include "program.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+// Little endian integer of size bytes
+std::uint32_t little(const unsigned char* bytes, int size) {
+	std::uint32_t value = 0;
+	
+	for(int i = size - 1; i >= 0; i--) {
+		value = value << 8 | bytes[i];
+	}
+	
+	return value;
+}
+
+Bitmap::Bitmap(const char* image, int codel_size) : file(image), codel_size(codel_size), palette() {
+	const unsigned char* data = file.data();
+	const std::size_t length = file.size();
+	
+	// The file header is 14 bytes, followed by an info header that starts with its own size
+	if(length < 26 || data[0] != 'B' || data[1] != 'M') {
+		throw std::runtime_error(std::string(image) + " is not a bitmap");
+	}
+	
+	offset = little(&data[10], 4);
+	
+	const std::uint32_t header = little(&data[14], 4);
+	std::uint32_t compression = 0;
+	std::uint32_t used = 0;
+	int entry = 4;
+	
+	if(header == 12) {
+		// The old OS/2 header has 16 bit sizes and 3 byte palette entries
+		pixel_width = little(&data[18], 2);
+		pixel_height = little(&data[20], 2);
+		bits = little(&data[24], 2);
+		entry = 3;
+	} else if(header >= 40) {
+		if(length < 54) {
+			throw std::runtime_error(std::string(image) + " is truncated");
+		}
+		
+		pixel_width = static_cast<std::int32_t>(little(&data[18], 4));
+		pixel_height = static_cast<std::int32_t>(little(&data[22], 4));
+		bits = little(&data[28], 2);
+		compression = little(&data[30], 4);
+		used = little(&data[46], 4);
+	} else {
+		throw std::runtime_error(std::string(image) + " has an unknown header");
+	}
+	
+	// Bit fields are only accepted when they describe the usual blue, green, red and alpha bytes
+	const bool fields = (compression == 3 || compression == 6) && bits == 32 && length >= 66 && little(&data[54], 4) == 0xFF0000 && little(&data[58], 4) == 0xFF00 && little(&data[62], 4) == 0xFF;
+	
+	if((compression != 0 && !fields) || (bits != 1 && bits != 4 && bits != 8 && bits != 24 && bits != 32)) {
+		throw std::runtime_error(std::string(image) + " uses an unsupported pixel format");
+	}
+	
+	// A negative height means the rows are stored top to bottom
+	top_down = pixel_height < 0;
+	pixel_height = top_down ? -pixel_height : pixel_height;
+	stride = (static_cast<std::uint64_t>(pixel_width) * bits + 31) / 32 * 4;
+	
+	if(pixel_width < 0 || offset > length || (stride > 0 && static_cast<std::uint64_t>(pixel_height) > (length - offset) / stride)) {
+		throw std::runtime_error(std::string(image) + " is truncated");
+	}
+	
+	if(bits <= 8) {
+		const std::uint64_t entries = used > 0 && used < (1u << bits) ? used : 1u << bits;
+		const std::uint64_t start = 14 + static_cast<std::uint64_t>(header);
+		
+		// Indices past the end of the palette are black
+		std::fill(palette, palette + 256, BLACK);
+		
+		for(std::uint64_t i = 0; i < entries && start + (i + 1) * entry <= length; i++) {
+			const unsigned char* color = &data[start + i * entry];
+			
+			palette[i] = classify(color[2], color[1], color[0]);
+		}
+	}
+	
+	columns = pixel_width / codel_size;
+	rows = pixel_height / codel_size;
+}
+
+void Bitmap::row(int y, unsigned char* colors) {
+	const std::int64_t line = static_cast<std::int64_t>(y) * codel_size + codel_size - 1;
+	const unsigned char* pixels = file.data() + offset + stride * (top_down ? line : pixel_height - 1 - line);
+	
+	if(bits <= 8) {
+		const unsigned mask = (1u << bits) - 1;
+		
+		for(int x = 0; x < columns; x++) {
+			const std::uint64_t position = static_cast<std::uint64_t>(x) * codel_size * bits;
+			
+			// The leftmost pixel sits in the highest bits of a byte
+			colors[x] = palette[pixels[position / 8] >> (8 - bits - position % 8) & mask];
+		}
+	} else if(bits == 24 && codel_size == 1) {
+		classify(pixels, columns, colors);
+	} else {
+		// Only the first three bytes of the first pixel of every codel count, those are gathered so the whole row can be classified at once
+		const std::size_t step = static_cast<std::size_t>(codel_size) * bits / 8;
+		std::vector<unsigned char> gathered(3 * static_cast<std::size_t>(columns));
+		
+		for(int x = 0; x < columns; x++) {
+			std::copy(&pixels[x * step], &pixels[x * step + 3], &gathered[3 * x]);
+		}
+		
+		classify(gathered.data(), columns, colors);
+	}
+}
@@ -0,0 +1,34 @@
+#ifndef PIET_BITMAP_H
+#define PIET_BITMAP_H
+
+#include "image.h"
+#include "mapping.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A bmp file mapped into memory, so only the rows being labeled need to be paged in. Takes 1, 4 and 8 bit images with a palette and 24 and 32 bit ones, stored either way up. Throws std::runtime_error for anything it cannot read
+class Bitmap : public Image {
+public:
+	Bitmap(const char* image, int codel_size);
+	
+	void row(int y, unsigned char* colors) override;
+	
+	bool random_access() const override {
+		return true;
+	}
+
+private:
+	Mapping file;
+	int codel_size;
+	std::int64_t pixel_width;
+	std::int64_t pixel_height;
+	int bits;                  // Per pixel
+	bool top_down;
+	std::uint64_t offset;      // Of the first row in the file
+	std::uint64_t stride;      // Bytes per row, padded to a multiple of 4
+	unsigned char palette[256];    // Color code of every palette entry
+};
+
+#endif //PIET_BITMAP_H
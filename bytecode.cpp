@@ -0,0 +1,351 @@
+#include "bytecode.h"
+
+#include "handlers.h"
+
+#include <utility>
+
+Bytecode::Bytecode(std::vector<Instruction> instructions, std::vector<std::uint32_t> entries, std::vector<std::uint32_t> blocks)
+		: code(std::move(instructions)), entries(std::move(entries)), blocks(std::move(blocks)) {}
+
+Bytecode compile(const Program& program) {
+	std::vector<Instruction> code;
+	std::vector<std::uint32_t> entries(program.block_count() * 8, UNCOMPILED);
+	std::vector<std::uint32_t> blocks;
+	
+	if(program.color(program.start()) == BLACK) {
+		code.push_back({HALT, 0});
+		blocks.push_back(program.start());
+		
+		return Bytecode(std::move(code), std::move(entries), std::move(blocks));
+	}
+	
+	std::vector<Location> pending = {program.start() * 8};
+	
+	while(!pending.empty()) {
+		Location location = pending.back();
+		pending.pop_back();
+		
+		if(entries[location] != UNCOMPILED) continue;
+		
+		// Follow the graph until the path depends on the stack, the program ends or it joins code that already exists
+		bool open = true;
+		
+		while(open && entries[location] == UNCOMPILED) {
+			entries[location] = code.size();
+			
+			const unsigned block = location / 8;
+			short dp = location / 2 % 4;
+			short cc = location % 2;
+			
+			if(!resolve(program, block, dp, cc)) {
+				code.push_back({HALT, 0});
+				blocks.push_back(block);
+				open = false;
+				break;
+			}
+			
+			const unsigned exit = dp * 2 + cc;
+			const Opcode opcode = program.opcode(block, exit);
+			const unsigned next = program.successor(block, exit);
+			
+			location = next * 8 + exit;
+			
+			switch(opcode) {
+				case SKIP:
+					break;
+				case PUSH:
+					code.push_back({PUSH, program.block_size(block)});
+					break;
+				case POINTER:
+					code.push_back({POINTER, location});
+					
+					for(int d = 0; d < 4; d++) {
+						pending.push_back(next * 8 + d * 2 + cc);
+					}
+					
+					open = false;
+					break;
+				case SWITCH:
+					code.push_back({SWITCH, location});
+					
+					for(int c = 0; c < 2; c++) {
+						pending.push_back(next * 8 + dp * 2 + c);
+					}
+					
+					open = false;
+					break;
+				default:
+					code.push_back({opcode, 0});
+			}
+			
+			blocks.resize(code.size(), block);
+		}
+		
+		if(open) {
+			code.push_back({JUMP, entries[location]});
+			blocks.push_back(location / 8);
+		}
+	}
+	
+	return Bytecode(std::move(code), std::move(entries), std::move(blocks));
+}
+
+// Every instruction that does not change control flow, indexed by instruction
+template<typename Cell>
+const command<Cell> handlers[INSTRUCTION_COUNT] = {
+		skip, add, divide, greater, duplicate, in_char,
+		push, subtract, mod, pointer, roll, out_number,
+		pop, multiply, nott, switchh, in_number, out_char,
+		skip, skip, skip,
+		add_immediate, subtract_immediate, multiply_immediate, square, roll_immediate, skip
+};
+
+const char* const names[INSTRUCTION_COUNT] = {
+		"skip", "add", "divide", "greater", "duplicate", "in_char",
+		"push", "subtract", "mod", "pointer", "roll", "out_number",
+		"pop", "multiply", "not", "switch", "in_number", "out_char",
+		"blocked", "jump", "halt",
+		"add_immediate", "subtract_immediate", "multiply_immediate", "square", "roll_immediate", "branch_immediate"
+};
+
+const char* instruction_name(unsigned char op) {
+	return op < INSTRUCTION_COUNT ? names[op] : "unknown";
+}
+
+// Number of Piet commands an instruction stands for, so step counts match the graph engine. Control flow counts nothing, a fused branch counts its push and its pointer or switch
+const unsigned char commands_per_instruction[INSTRUCTION_COUNT] = {
+		0, 1, 1, 1, 1, 1,
+		1, 1, 1, 1, 1, 1,
+		1, 1, 1, 1, 1, 1,
+		0, 0, 0,
+		2, 2, 2, 2, 3, 2
+};
+
+// Sets up the VM for the Location a POINTER or SWITCH leaves towards, lets it change direction and returns where the code for the new direction is
+template<typename Cell>
+inline std::uint32_t branch(const Bytecode& bytecode, VM<Cell>& vm, Opcode opcode, Location location) {
+	vm.block = location / 8;
+	vm.dp = location / 2 % 4;
+	vm.cc = location % 2;
+	
+	if(opcode == POINTER) {
+		pointer(vm, 0);
+	} else {
+		switchh(vm, 0);
+	}
+	
+	return bytecode.entry(vm.block * 8 + vm.dp * 2 + vm.cc);
+}
+
+template<typename Cell>
+void run_call(const Bytecode& bytecode, VM<Cell>& vm) {
+	const Instruction* code = bytecode.instructions().data();
+	std::uint32_t pc = bytecode.start();
+	
+	try {
+		while(true) {
+			const Instruction& instruction = code[pc++];
+			
+			count(vm, commands_per_instruction[instruction.op]);
+			
+			switch(instruction.op) {
+				case JUMP:
+				case BRANCH_IMMEDIATE:
+					pc = instruction.operand;
+					break;
+				case HALT:
+					return;
+				case POINTER:
+				case SWITCH:
+					// The direction only becomes known here, so pick the code for the new dp and cc
+					vm.block = instruction.operand / 8;
+					vm.dp = instruction.operand / 2 % 4;
+					vm.cc = instruction.operand % 2;
+					
+					handlers<Cell>[instruction.op](vm, 0);
+					
+					pc = bytecode.entry(vm.block * 8 + vm.dp * 2 + vm.cc);
+					break;
+				default:
+					handlers<Cell>[instruction.op](vm, instruction.operand);
+			}
+		}
+	} catch(const Overflow&) {
+		vm.block = bytecode.block(pc - 1);
+		throw;
+	}
+}
+
+template<typename Cell>
+void run_switch(const Bytecode& bytecode, VM<Cell>& vm) {
+	const Instruction* code = bytecode.instructions().data();
+	std::uint32_t pc = bytecode.start();
+	
+	try {
+		while(true) {
+			const Instruction& instruction = code[pc++];
+			
+			count(vm, commands_per_instruction[instruction.op]);
+			
+			switch(instruction.op) {
+				case PUSH: push(vm, instruction.operand); break;
+				case POP: pop(vm, 0); break;
+				case ADD: add(vm, 0); break;
+				case SUBTRACT: subtract(vm, 0); break;
+				case MULTIPLY: multiply(vm, 0); break;
+				case DIVIDE: divide(vm, 0); break;
+				case MOD: mod(vm, 0); break;
+				case NOT: nott(vm, 0); break;
+				case GREATER: greater(vm, 0); break;
+				case DUPLICATE: duplicate(vm, 0); break;
+				case ROLL: roll(vm, 0); break;
+				case IN_NUMBER: in_number(vm, 0); break;
+				case IN_CHAR: in_char(vm, 0); break;
+				case OUT_NUMBER: out_number(vm, 0); break;
+				case OUT_CHAR: out_char(vm, 0); break;
+				case ADD_IMMEDIATE: add_immediate(vm, instruction.operand); break;
+				case SUBTRACT_IMMEDIATE: subtract_immediate(vm, instruction.operand); break;
+				case MULTIPLY_IMMEDIATE: multiply_immediate(vm, instruction.operand); break;
+				case SQUARE: square(vm, 0); break;
+				case ROLL_IMMEDIATE: roll_immediate(vm, instruction.operand); break;
+				case POINTER:
+				case SWITCH:
+					pc = branch(bytecode, vm, static_cast<Opcode>(instruction.op), instruction.operand);
+					break;
+				case JUMP:
+				case BRANCH_IMMEDIATE:
+					pc = instruction.operand;
+					break;
+				default:
+					return;
+			}
+		}
+	} catch(const Overflow&) {
+		vm.block = bytecode.block(pc - 1);
+		throw;
+	}
+}
+
+#if defined(__GNUC__)
+
+template<typename Cell>
+void run_threaded(const Bytecode& bytecode, VM<Cell>& vm) {
+	// Indexed by instruction, SKIP and BLOCKED are never emitted
+	static const void* const labels[INSTRUCTION_COUNT] = {
+			&&halt, &&add, &&divide, &&greater, &&duplicate, &&in_char,
+			&&push, &&subtract, &&mod, &&pointer, &&roll, &&out_number,
+			&&pop, &&multiply, &&nott, &&switchh, &&in_number, &&out_char,
+			&&halt, &&jump, &&halt,
+			&&add_immediate, &&subtract_immediate, &&multiply_immediate, &&square, &&roll_immediate, &&jump
+	};
+	
+	struct Threaded {
+		const void* handler;
+		std::uint32_t operand;
+		std::uint32_t commands;
+	};
+	
+	const std::vector<Instruction>& code = bytecode.instructions();
+	std::vector<Threaded> threaded(code.size());
+	
+	for(std::size_t i = 0; i < code.size(); i++) {
+		threaded[i] = {labels[code[i].op], code[i].operand, commands_per_instruction[code[i].op]};
+	}
+	
+	const Threaded* base = threaded.data();
+	const Threaded* ip = base + bytecode.start();
+	std::uint32_t operand;
+	
+	// Every handler ends in its own indirect jump, so each one gets its own branch prediction
+#define DISPATCH() count(vm, ip->commands); operand = ip->operand; goto *(ip++)->handler
+	
+	try {
+		DISPATCH();
+		
+		push: push(vm, operand); DISPATCH();
+		pop: pop(vm, 0); DISPATCH();
+		add: add(vm, 0); DISPATCH();
+		subtract: subtract(vm, 0); DISPATCH();
+		multiply: multiply(vm, 0); DISPATCH();
+		divide: divide(vm, 0); DISPATCH();
+		mod: mod(vm, 0); DISPATCH();
+		nott: nott(vm, 0); DISPATCH();
+		greater: greater(vm, 0); DISPATCH();
+		duplicate: duplicate(vm, 0); DISPATCH();
+		roll: roll(vm, 0); DISPATCH();
+		in_number: in_number(vm, 0); DISPATCH();
+		in_char: in_char(vm, 0); DISPATCH();
+		out_number: out_number(vm, 0); DISPATCH();
+		out_char: out_char(vm, 0); DISPATCH();
+		add_immediate: add_immediate(vm, operand); DISPATCH();
+		subtract_immediate: subtract_immediate(vm, operand); DISPATCH();
+		multiply_immediate: multiply_immediate(vm, operand); DISPATCH();
+		square: square(vm, 0); DISPATCH();
+		roll_immediate: roll_immediate(vm, operand); DISPATCH();
+		pointer: ip = base + branch(bytecode, vm, POINTER, operand); DISPATCH();
+		switchh: ip = base + branch(bytecode, vm, SWITCH, operand); DISPATCH();
+		jump: ip = base + operand; DISPATCH();
+		halt: return;
+	} catch(const Overflow&) {
+		vm.block = bytecode.block(ip - base - 1);
+		throw;
+	}
+
+#undef DISPATCH
+}
+
+#else
+
+template<typename Cell>
+void run_threaded(const Bytecode& bytecode, VM<Cell>& vm) {
+	run_switch(bytecode, vm);
+}
+
+#endif
+
+template<typename Cell>
+std::uint32_t step(const Bytecode& bytecode, VM<Cell>& vm, std::uint32_t pc) {
+	const Instruction& instruction = bytecode.instructions()[pc];
+	
+	count(vm, commands_per_instruction[instruction.op]);
+	
+	try {
+		switch(instruction.op) {
+			case JUMP:
+			case BRANCH_IMMEDIATE:
+				return instruction.operand;
+			case HALT:
+				return UNCOMPILED;
+			case POINTER:
+			case SWITCH:
+				return branch(bytecode, vm, static_cast<Opcode>(instruction.op), instruction.operand);
+			default:
+				handlers<Cell>[instruction.op](vm, instruction.operand);
+				return pc + 1;
+		}
+	} catch(const Overflow&) {
+		vm.block = bytecode.block(pc);
+		throw;
+	}
+}
+
+template<typename Cell>
+void run(const Bytecode& bytecode, VM<Cell>& vm, Dispatch dispatch) {
+	switch(dispatch) {
+		case CALL_DISPATCH:
+			run_call(bytecode, vm);
+			break;
+		case SWITCH_DISPATCH:
+			run_switch(bytecode, vm);
+			break;
+		case THREADED_DISPATCH:
+			run_threaded(bytecode, vm);
+			break;
+	}
+}
+
+#define INSTANTIATE(Cell) \
+	template std::uint32_t step(const Bytecode& bytecode, VM<Cell>& vm, std::uint32_t pc); \
+	template void run(const Bytecode& bytecode, VM<Cell>& vm, Dispatch dispatch);
+
+PIET_CELLS(INSTANTIATE)
@@ -0,0 +1,91 @@
+#ifndef PIET_BYTECODE_H
+#define PIET_BYTECODE_H
+
+#include "program.h"
+#include "vm.h"
+
+#include <cstdint>
+#include <vector>
+
+// Instructions are the Opcodes of the transitions that do something, plus control flow. SKIP and BLOCKED never appear
+enum Control : unsigned char {
+	JUMP = BLOCKED + 1,    // Continue at the operand
+	HALT
+};
+
+// Superinstructions replace common sequences of instructions, see fusion.h
+enum Superinstruction : unsigned char {
+	ADD_IMMEDIATE = HALT + 1,    // push, add
+	SUBTRACT_IMMEDIATE,          // push, subtract
+	MULTIPLY_IMMEDIATE,          // push, multiply
+	SQUARE,                      // duplicate, multiply
+	ROLL_IMMEDIATE,              // push, push, roll with the depth in the high and the count in the low 16 bits of the operand
+	BRANCH_IMMEDIATE,            // push, pointer or push, switch, whose new direction is known, so it continues at the operand like a JUMP
+	INSTRUCTION_COUNT
+};
+
+// An execution state of the block graph: block * 8 + dp * 2 + cc
+typedef std::uint32_t Location;
+
+const std::uint32_t UNCOMPILED = UINT32_MAX;
+
+struct Instruction {
+	unsigned char op;
+	std::uint32_t operand;    // Block size for PUSH and immediates, target for JUMP and BRANCH_IMMEDIATE, Location entered after POINTER and SWITCH
+};
+
+// The block graph lowered to straight-line code. As long as dp and cc are known the path through the graph is fixed, blocked exits included, so only POINTER and SWITCH need to look anything up at runtime
+class Bytecode {
+public:
+	Bytecode(std::vector<Instruction> instructions, std::vector<std::uint32_t> entries, std::vector<std::uint32_t> blocks);
+	
+	const std::vector<Instruction>& instructions() const {
+		return code;
+	}
+	
+	// Number of Locations, 8 per block
+	std::uint32_t locations() const {
+		return entries.size();
+	}
+	
+	// Address of the code for a Location, or UNCOMPILED if it can not be reached
+	std::uint32_t entry(Location location) const {
+		return entries[location];
+	}
+	
+	// The block being left when an instruction runs, for diagnostics. Like the graph engine, an overflow is reported in the block whose command caused it
+	std::uint32_t block(std::uint32_t pc) const {
+		return blocks[pc];
+	}
+	
+	// Address to start executing at
+	std::uint32_t start() const {
+		return 0;
+	}
+
+private:
+	std::vector<Instruction> code;
+	std::vector<std::uint32_t> entries;
+	std::vector<std::uint32_t> blocks;
+};
+
+// How the interpreter gets from one instruction to the next
+enum Dispatch {
+	CALL_DISPATCH,        // Indirect call through the commands table
+	SWITCH_DISPATCH,      // One switch with every handler inlined
+	THREADED_DISPATCH     // Every instruction carries the address of its handler, falls back to a switch without labels as values
+};
+
+Bytecode compile(const Program& program);
+
+const char* instruction_name(unsigned char op);
+
+// Executes the instruction at pc and returns the address of the next one, or UNCOMPILED once the program halts
+template<typename Cell>
+std::uint32_t step(const Bytecode& bytecode, VM<Cell>& vm, std::uint32_t pc);
+
+// Runs until the program terminates. The VM only needs a stack, dp and cc are encoded in the code
+template<typename Cell>
+void run(const Bytecode& bytecode, VM<Cell>& vm, Dispatch dispatch = THREADED_DISPATCH);
+
+#endif //PIET_BYTECODE_H
@@ -0,0 +1,152 @@
+#include "cache.h"
+
+#include "mapping.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+// Starts every cached Program, followed by the successors, sizes, opcodes and colors of all blocks in that order, which keeps every array aligned. Order is written in the byte order of the machine, so a cache from another architecture reads as incompatible
+struct Header {
+	char magic[4];
+	std::uint32_t version;
+	std::uint32_t order;
+	std::uint32_t count;    // Of blocks
+};
+
+// Goes up whenever the layout or the Program an image loads into changes
+const std::uint32_t VERSION = 1;
+const std::uint32_t ORDER = 0x01020304;
+
+// Bytes every block takes after the header
+const std::uint64_t BLOCK_BYTES = 8 * 4 + 4 + 8 + 1;
+
+const std::uint64_t PRIME1 = 0x9E3779B185EBCA87;
+const std::uint64_t PRIME2 = 0xC2B2AE3D27D4EB4F;
+
+std::uint64_t rotate(std::uint64_t value, int bits) {
+	return value << bits | value >> (64 - bits);
+}
+
+std::uint64_t mix(std::uint64_t lane, std::uint64_t word) {
+	return rotate(lane + word * PRIME2, 31) * PRIME1;
+}
+
+// A 64 bit hash that takes 32 bytes at a time in four independent lanes, so it keeps up with reading the file. It tells images apart, but is not meant to withstand collisions made on purpose
+std::uint64_t content_hash(const unsigned char* data, std::size_t length) {
+	std::uint64_t lanes[4] = {PRIME1 + PRIME2, PRIME2, 0, 0 - PRIME1};
+	std::size_t i = 0;
+	
+	for(; i + 32 <= length; i += 32) {
+		for(int lane = 0; lane < 4; lane++) {
+			std::uint64_t word;
+			
+			std::memcpy(&word, data + i + lane * 8, 8);
+			lanes[lane] = mix(lanes[lane], word);
+		}
+	}
+	
+	std::uint64_t hash = length * PRIME1;
+	
+	for(int lane = 0; lane < 4; lane++) {
+		hash = rotate(hash ^ mix(0, lanes[lane]), 27) * PRIME1 + PRIME2;
+	}
+	
+	for(; i < length; i++) {
+		hash = rotate(hash ^ data[i] * PRIME1, 11) * PRIME2;
+	}
+	
+	// Every bit of the input affects every bit of the hash
+	hash ^= hash >> 33;
+	hash *= PRIME2;
+	hash ^= hash >> 29;
+	hash *= PRIME1;
+	
+	return hash ^ hash >> 32;
+}
+
+std::string cache_file(const char* directory, const char* image, int codel_size) {
+	const Mapping file(image);
+	char name[64];
+	
+	std::snprintf(name, sizeof(name), "/%016llx-%d.pietc", static_cast<unsigned long long>(content_hash(file.data(), file.size())), codel_size);
+	
+	return directory + std::string(name);
+}
+
+bool load_cached(const std::string& file, Program& program) {
+	std::shared_ptr<const Mapping> mapping;
+	
+	try {
+		// Blocks are visited in whatever order the program jumps around in
+		mapping = std::make_shared<const Mapping>(file.c_str(), false);
+	} catch(const std::runtime_error&) {
+		return false;
+	}
+	
+	Header header;
+	
+	if(mapping->size() < sizeof(header)) return false;
+	
+	std::memcpy(&header, mapping->data(), sizeof(header));
+	
+	const std::uint64_t count = header.count;
+	
+	if(std::memcmp(header.magic, "PIET", 4) != 0 || header.version != VERSION || header.order != ORDER || count == 0 || mapping->size() != sizeof(header) + count * BLOCK_BYTES) return false;
+	
+	const unsigned char* arrays = mapping->data() + sizeof(header);
+	const std::uint32_t* successors = reinterpret_cast<const std::uint32_t*>(arrays);
+	const unsigned char* opcodes = arrays + count * 36;
+	const unsigned char* colors = arrays + count * 44;
+	
+	// Every engine indexes with these unchecked, so a damaged file must not get that far. One pass over the file, which is still far less than loading the image
+	for(std::uint64_t i = 0; i < count * 8; i++) {
+		if(successors[i] >= count || opcodes[i] > BLOCKED) return false;
+	}
+	
+	for(std::uint64_t i = 0; i < count; i++) {
+		if(colors[i] > BLACK) return false;
+	}
+	
+	program = Program(mapping, count, successors, reinterpret_cast<const Opcode*>(opcodes), reinterpret_cast<const std::uint32_t*>(arrays + count * 32), colors);
+	
+	return true;
+}
+
+void save_cached(const Program& program, const std::string& file) {
+	const unsigned count = program.block_count();
+	const Header header = {{'P', 'I', 'E', 'T'}, VERSION, ORDER, count};
+	
+	std::vector<std::uint32_t> successors(count * 8);
+	std::vector<std::uint32_t> sizes(count);
+	std::vector<unsigned char> opcodes(count * 8);
+	std::vector<unsigned char> colors(count);
+	
+	for(unsigned block = 0; block < count; block++) {
+		for(unsigned exit = 0; exit < 8; exit++) {
+			successors[block * 8 + exit] = program.successor(block, exit);
+			opcodes[block * 8 + exit] = program.opcode(block, exit);
+		}
+		
+		sizes[block] = program.block_size(block);
+		colors[block] = program.color(block);
+	}
+	
+	// Named so that processes caching the same image at once do not write over each other
+	const std::string temporary = file + "." + std::to_string(std::random_device()()) + ".tmp";
+	std::ofstream out(temporary, std::ios::binary);
+	
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.write(reinterpret_cast<const char*>(successors.data()), successors.size() * 4);
+	out.write(reinterpret_cast<const char*>(sizes.data()), sizes.size() * 4);
+	out.write(reinterpret_cast<const char*>(opcodes.data()), opcodes.size());
+	out.write(reinterpret_cast<const char*>(colors.data()), colors.size());
+	out.close();
+	
+	if(!out || std::rename(temporary.c_str(), file.c_str()) != 0) {
+		std::remove(temporary.c_str());
+	}
+}
@@ -0,0 +1,17 @@
+#ifndef PIET_CACHE_H
+#define PIET_CACHE_H
+
+#include "program.h"
+
+#include <string>
+
+// File in directory that caches the Program of an image read with a codel size, 0 meaning detected. It is named after a hash of the contents of the image, so an edited image never finds an old Program. Throws std::runtime_error if the image cannot be read
+std::string cache_file(const char* directory, const char* image, int codel_size);
+
+// Maps a Program written by save_cached, which then runs straight from the mapping. Returns false if there is none, or it was written by an incompatible build
+bool load_cached(const std::string& file, Program& program);
+
+// Writes a Program for load_cached through a temporary file, so other processes never map half of one. Failing to write is ignored, the next run only has to load the image again. The directory has to exist
+void save_cached(const Program& program, const std::string& file);
+
+#endif //PIET_CACHE_H
@@ -0,0 +1,54 @@
+#include "cell.h"
+
+#include <cctype>
+
+#if defined(__SIZEOF_INT128__)
+
+std::ostream& operator<<(std::ostream& out, int128 value) {
+	const unsigned __int128 magnitude = value < 0 ? 0 - static_cast<unsigned __int128>(value) : value;
+	std::string digits;
+	
+	for(unsigned __int128 rest = magnitude; rest || digits.empty(); rest /= 10) {
+		digits.insert(digits.begin(), static_cast<char>('0' + rest % 10));
+	}
+	
+	if(value < 0) {
+		digits.insert(digits.begin(), '-');
+	}
+	
+	return out << digits;
+}
+
+// Values that do not fit wrap around. Like the built in integers it reads 0 when there is no number, also once the stream has ended
+std::istream& operator>>(std::istream& in, int128& value) {
+	std::istream::sentry sentry(in);
+	
+	if(!sentry) {
+		value = 0;
+		return in;
+	}
+	
+	bool negative = false;
+	
+	if(in.peek() == '-' || in.peek() == '+') {
+		negative = in.get() == '-';
+	}
+	
+	if(!std::isdigit(in.peek())) {
+		value = 0;
+		in.setstate(std::ios::failbit);
+		return in;
+	}
+	
+	unsigned __int128 magnitude = 0;
+	
+	while(std::isdigit(in.peek())) {
+		magnitude = magnitude * 10 + (in.get() - '0');
+	}
+	
+	value = negative ? 0 - magnitude : magnitude;
+	
+	return in;
+}
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef PIET_CELL_H
+#define PIET_CELL_H
+
+#include "big.h"
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+// The type of the values on the stack is a template parameter of everything that runs a program. These are the ones it gets instantiated for
+
+#if defined(__SIZEOF_INT128__)
+
+typedef __int128 int128;
+
+std::ostream& operator<<(std::ostream& out, int128 value);
+std::istream& operator>>(std::istream& in, int128& value);
+
+#define PIET_INT128(instantiate) instantiate(int128)
+#else
+#define PIET_INT128(instantiate)
+#endif
+
+// Thrown by checked cells when a result does not fit
+struct Overflow : std::overflow_error {
+	Overflow() : std::overflow_error("arithmetic overflow") {}
+};
+
+// A fixed width integer whose arithmetic traps instead of overflowing. The checks are single compiler builtins, so results that fit cost a flag test
+template<typename T>
+class Checked {
+public:
+	Checked(std::int64_t value = 0) : value(static_cast<T>(value)) {}
+	
+	explicit operator std::int64_t() const {
+		return value;
+	}
+	
+	bool operator!() const {
+		return !value;
+	}
+	
+	friend Checked operator+(Checked a, Checked b) {
+		T result;
+		
+		if(__builtin_add_overflow(a.value, b.value, &result)) throw Overflow();
+		
+		return wrap(result);
+	}
+	
+	friend Checked operator-(Checked a, Checked b) {
+		T result;
+		
+		if(__builtin_sub_overflow(a.value, b.value, &result)) throw Overflow();
+		
+		return wrap(result);
+	}
+	
+	friend Checked operator*(Checked a, Checked b) {
+		T result;
+		
+		if(__builtin_mul_overflow(a.value, b.value, &result)) throw Overflow();
+		
+		return wrap(result);
+	}
+	
+	friend Checked operator/(Checked a, Checked b) {
+		if(b.value == -1) return Checked() - a;
+		
+		return wrap(a.value / b.value);
+	}
+	
+	friend Checked operator%(Checked a, Checked b) {
+		if(b.value == -1) return Checked();
+		
+		return wrap(a.value % b.value);
+	}
+	
+	Checked& operator+=(Checked other) {
+		return *this = *this + other;
+	}
+	
+	Checked& operator-=(Checked other) {
+		return *this = *this - other;
+	}
+	
+	Checked& operator*=(Checked other) {
+		return *this = *this * other;
+	}
+	
+	friend bool operator==(Checked a, Checked b) {
+		return a.value == b.value;
+	}
+	
+	friend bool operator<(Checked a, Checked b) {
+		return a.value < b.value;
+	}
+	
+	friend bool operator>(Checked a, Checked b) {
+		return a.value > b.value;
+	}
+	
+	friend std::ostream& operator<<(std::ostream& out, Checked value) {
+		return out << value.value;
+	}
+	
+	friend std::istream& operator>>(std::istream& in, Checked& value) {
+		return in >> value.value;
+	}
+
+private:
+	T value;
+	
+	// Builds a cell from a T without going through the 64 bit constructor
+	static Checked wrap(T value) {
+		Checked cell;
+		
+		cell.value = value;
+		
+		return cell;
+	}
+};
+
+template<typename Cell>
+struct is_checked : std::false_type {};
+
+template<typename T>
+struct is_checked<Checked<T>> : std::true_type {};
+
+// Applies a macro to every cell type, for explicit instantiations
+#define PIET_CELLS(instantiate) instantiate(std::int32_t) instantiate(std::int64_t) PIET_INT128(instantiate) instantiate(Big) \
+	instantiate(Checked<std::int32_t>) instantiate(Checked<std::int64_t>)
+
+// The value modulo a positive modulus, always in [0, modulus)
+template<typename Cell>
+std::int64_t residue(const Cell& value, std::int64_t modulus) {
+	const Cell m = static_cast<Cell>(modulus);
+	Cell r = value % m;
+	
+	if(r < Cell(0)) {
+		r = r + m;
+	}
+	
+	return static_cast<std::int64_t>(r);
+}
+
+#endif //PIET_CELL_H
@@ -0,0 +1,274 @@
+#include "classify.h"
+
+#include "program.h"
+
+#if PIET_SIMD
+#include <immintrin.h>
+#endif
+
+unsigned char classify(int red, int green, int blue) {
+	if(red < 32) {
+		if(green < 32) {
+			if(blue < 32) {
+				return color_code({DARK, NONE});
+			} else if(blue > 224) {
+				return color_code({NORMAL, BLUE});
+			} else {
+				return color_code({DARK, BLUE});
+			}
+		} else if(green > 224) {
+			if(blue < 32) {
+				return color_code({NORMAL, GREEN});
+			} else {
+				return color_code({NORMAL, CYAN});
+			}
+		} else {
+			if(blue < 32) {
+				return color_code({DARK, GREEN});
+			} else {
+				return color_code({DARK, CYAN});
+			}
+		}
+	} else if (red > 224) {
+		if(green < 32) {
+			if(blue < 32) {
+				return color_code({NORMAL, RED});
+			} else {
+				return color_code({NORMAL, MAGENTA});
+			}
+		} else if(green > 224) {
+			if(blue < 32) {
+				return color_code({NORMAL, YELLOW});
+			} else if(blue > 224) {
+				return color_code({LIGHT, NONE});
+			} else {
+				return color_code({LIGHT, YELLOW});
+			}
+		} else {
+			if(blue <= 224) {
+				return color_code({LIGHT, RED});
+			} else {
+				return color_code({LIGHT, MAGENTA});
+			}
+		}
+	} else {
+		if(green < 32) {
+			if(blue < 32) {
+				return color_code({DARK, RED});
+			} else {
+				return color_code({DARK, MAGENTA});
+			}
+		} else if(green > 224) {
+			if(blue <= 224) {
+				return color_code({LIGHT, GREEN});
+			} else {
+				return color_code({LIGHT, CYAN});
+			}
+		} else {
+			if(blue < 32) {
+				return color_code({DARK, YELLOW});
+			} else {
+				return color_code({LIGHT, BLUE});
+			}
+		}
+	}
+}
+
+void classify_scalar(const unsigned char* pixels, std::size_t count, unsigned char* colors) {
+	for(std::size_t i = 0; i < count; i++) {
+		colors[i] = classify(pixels[3 * i + 2], pixels[3 * i + 1], pixels[3 * i]);
+	}
+}
+
+#if PIET_SIMD
+
+// The tree above only ever asks whether a channel is below 32, in between or above 224, so a pixel is one of 27 combinations of those classes. This is the color code of each, indexed by red * 9 + green * 3 + blue and taken from the tree itself so the kernels cannot disagree with it
+struct Lookup {
+	unsigned char codes[32];
+	
+	Lookup() : codes() {
+		const int levels[3] = {0, 128, 255};
+		
+		for(int red = 0; red < 3; red++) {
+			for(int green = 0; green < 3; green++) {
+				for(int blue = 0; blue < 3; blue++) {
+					codes[red * 9 + green * 3 + blue] = classify(levels[red], levels[green], levels[blue]);
+				}
+			}
+		}
+	}
+};
+
+const Lookup lookup;
+
+// Shuffle controls that pick one channel of 16 consecutive pixels out of each of the three vectors holding them, pixels that live in another vector get zero
+struct Gather {
+	signed char controls[3][3][16];
+	
+	constexpr Gather() : controls() {
+		for(int channel = 0; channel < 3; channel++) {
+			for(int vector = 0; vector < 3; vector++) {
+				for(int pixel = 0; pixel < 16; pixel++) {
+					const int source = 3 * pixel + channel;
+					
+					controls[channel][vector][pixel] = source / 16 == vector ? source % 16 : -128;
+				}
+			}
+		}
+	}
+};
+
+constexpr Gather gather;
+
+// Class of every byte: 0 below 32, 1 up to 224 and 2 above. Bytes are unsigned, so they are flipped into signed order before comparing
+__attribute__((target("ssse3")))
+inline __m128i channel_classes(__m128i bytes) {
+	const __m128i flipped = _mm_xor_si128(bytes, _mm_set1_epi8(-128));
+	const __m128i above_dark = _mm_cmpgt_epi8(flipped, _mm_set1_epi8(31 - 128));
+	const __m128i above_normal = _mm_cmpgt_epi8(flipped, _mm_set1_epi8(224 - 128));
+	
+	// Both masks are -1 where they hold
+	return _mm_sub_epi8(_mm_sub_epi8(_mm_setzero_si128(), above_dark), above_normal);
+}
+
+__attribute__((target("ssse3")))
+inline __m128i channel(const __m128i classes[3], const __m128i controls[3]) {
+	return _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(classes[0], controls[0]), _mm_shuffle_epi8(classes[1], controls[1])), _mm_shuffle_epi8(classes[2], controls[2]));
+}
+
+__attribute__((target("ssse3")))
+void classify_ssse3(const unsigned char* pixels, std::size_t count, unsigned char* colors) {
+	const __m128i low_codes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lookup.codes));
+	const __m128i high_codes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lookup.codes + 16));
+	__m128i controls[3][3];
+	
+	for(int c = 0; c < 3; c++) {
+		for(int v = 0; v < 3; v++) {
+			controls[c][v] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(gather.controls[c][v]));
+		}
+	}
+	
+	std::size_t i = 0;
+	
+	for(; i + 16 <= count; i += 16) {
+		const __m128i* source = reinterpret_cast<const __m128i*>(pixels + 3 * i);
+		const __m128i classes[3] = {channel_classes(_mm_loadu_si128(source)), channel_classes(_mm_loadu_si128(source + 1)), channel_classes(_mm_loadu_si128(source + 2))};
+		
+		const __m128i blue = channel(classes, controls[0]);
+		const __m128i green = channel(classes, controls[1]);
+		const __m128i red = channel(classes, controls[2]);
+		
+		// There are no byte multiplications, red * 9 is red doubled three times plus red
+		const __m128i red2 = _mm_add_epi8(red, red);
+		const __m128i red4 = _mm_add_epi8(red2, red2);
+		const __m128i red9 = _mm_add_epi8(_mm_add_epi8(red4, red4), red);
+		const __m128i green3 = _mm_add_epi8(_mm_add_epi8(green, green), green);
+		const __m128i index = _mm_add_epi8(_mm_add_epi8(red9, green3), blue);
+		
+		// A shuffle looks up 16 entries and gives zero for controls with the top bit set, so each half of the table zeroes the indices of the other
+		const __m128i high = _mm_cmpgt_epi8(index, _mm_set1_epi8(15));
+		const __m128i low_half = _mm_shuffle_epi8(low_codes, _mm_or_si128(index, high));
+		const __m128i high_half = _mm_shuffle_epi8(high_codes, _mm_sub_epi8(index, _mm_set1_epi8(16)));
+		
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(colors + i), _mm_or_si128(low_half, high_half));
+	}
+	
+	classify_scalar(pixels + 3 * i, count - i, colors + i);
+}
+
+// The same as above with 16 pixels in each half, since shuffles never cross from one half of a register to the other
+__attribute__((target("avx2")))
+inline __m256i channel_classes(__m256i bytes) {
+	const __m256i flipped = _mm256_xor_si256(bytes, _mm256_set1_epi8(-128));
+	const __m256i above_dark = _mm256_cmpgt_epi8(flipped, _mm256_set1_epi8(31 - 128));
+	const __m256i above_normal = _mm256_cmpgt_epi8(flipped, _mm256_set1_epi8(224 - 128));
+	
+	return _mm256_sub_epi8(_mm256_sub_epi8(_mm256_setzero_si256(), above_dark), above_normal);
+}
+
+__attribute__((target("avx2")))
+inline __m256i load_halves(const unsigned char* low, const unsigned char* high) {
+	return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(low))), _mm_loadu_si128(reinterpret_cast<const __m128i*>(high)), 1);
+}
+
+__attribute__((target("avx2")))
+inline __m256i channel(const __m256i classes[3], const __m256i controls[3]) {
+	return _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(classes[0], controls[0]), _mm256_shuffle_epi8(classes[1], controls[1])), _mm256_shuffle_epi8(classes[2], controls[2]));
+}
+
+__attribute__((target("avx2")))
+void classify_avx2(const unsigned char* pixels, std::size_t count, unsigned char* colors) {
+	const __m256i low_codes = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(lookup.codes)));
+	const __m256i high_codes = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(lookup.codes + 16)));
+	__m256i controls[3][3];
+	
+	for(int c = 0; c < 3; c++) {
+		for(int v = 0; v < 3; v++) {
+			controls[c][v] = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(gather.controls[c][v])));
+		}
+	}
+	
+	std::size_t i = 0;
+	
+	for(; i + 32 <= count; i += 32) {
+		// Pixels i to i + 15 go in the low halves, i + 16 to i + 31 in the high halves
+		const unsigned char* source = pixels + 3 * i;
+		const __m256i classes[3] = {channel_classes(load_halves(source, source + 48)), channel_classes(load_halves(source + 16, source + 64)), channel_classes(load_halves(source + 32, source + 80))};
+		
+		const __m256i blue = channel(classes, controls[0]);
+		const __m256i green = channel(classes, controls[1]);
+		const __m256i red = channel(classes, controls[2]);
+		
+		const __m256i red2 = _mm256_add_epi8(red, red);
+		const __m256i red4 = _mm256_add_epi8(red2, red2);
+		const __m256i red9 = _mm256_add_epi8(_mm256_add_epi8(red4, red4), red);
+		const __m256i green3 = _mm256_add_epi8(_mm256_add_epi8(green, green), green);
+		const __m256i index = _mm256_add_epi8(_mm256_add_epi8(red9, green3), blue);
+		
+		const __m256i high = _mm256_cmpgt_epi8(index, _mm256_set1_epi8(15));
+		const __m256i low_half = _mm256_shuffle_epi8(low_codes, _mm256_or_si256(index, high));
+		const __m256i high_half = _mm256_shuffle_epi8(high_codes, _mm256_sub_epi8(index, _mm256_set1_epi8(16)));
+		
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(colors + i), _mm256_or_si256(low_half, high_half));
+	}
+	
+	classify_ssse3(pixels + 3 * i, count - i, colors + i);
+}
+
+#endif
+
+bool supported(Classifier classifier) {
+	switch(classifier) {
+#if PIET_SIMD
+		case SSSE3_CLASSIFIER:
+			return __builtin_cpu_supports("ssse3");
+		case AVX2_CLASSIFIER:
+			return __builtin_cpu_supports("avx2");
+#endif
+		case SCALAR_CLASSIFIER:
+			return true;
+		default:
+			return false;
+	}
+}
+
+Classifier best_classifier() {
+	static const Classifier best = supported(AVX2_CLASSIFIER) ? AVX2_CLASSIFIER : supported(SSSE3_CLASSIFIER) ? SSSE3_CLASSIFIER : SCALAR_CLASSIFIER;
+	
+	return best;
+}
+
+void classify(const unsigned char* pixels, std::size_t count, unsigned char* colors, Classifier classifier) {
+	switch(classifier) {
+#if PIET_SIMD
+		case AVX2_CLASSIFIER:
+			classify_avx2(pixels, count, colors);
+			break;
+		case SSSE3_CLASSIFIER:
+			classify_ssse3(pixels, count, colors);
+			break;
+#endif
+		default:
+			classify_scalar(pixels, count, colors);
+	}
+}
@@ -0,0 +1,31 @@
+#ifndef PIET_CLASSIFY_H
+#define PIET_CLASSIFY_H
+
+#include <cstddef>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PIET_SIMD 1
+#else
+#define PIET_SIMD 0
+#endif
+
+// How pixels are turned into color codes, from slowest to fastest. Every classifier gives exactly the same codes
+enum Classifier {
+	SCALAR_CLASSIFIER,    // One pixel at a time through a tree of comparisons
+	SSSE3_CLASSIFIER,     // 16 pixels at a time
+	AVX2_CLASSIFIER       // 32 pixels at a time
+};
+
+// Classifies a pixel as one of the twenty colors, anything that is not a Piet color gets the nearest one
+unsigned char classify(int red, int green, int blue);
+
+// Whether this processor can run a classifier
+bool supported(Classifier classifier);
+
+// The fastest classifier this processor can run, checked once
+Classifier best_classifier();
+
+// Classifies count pixels stored as blue, green, red triplets without gaps, which is how bitmaps store them
+void classify(const unsigned char* pixels, std::size_t count, unsigned char* colors, Classifier classifier = best_classifier());
+
+#endif //PIET_CLASSIFY_H
@@ -0,0 +1,23 @@
+#include "bytecode.h"
+#include "fusion.h"
+#include "jit.h"
+#include "program.h"
+#include "propagate.h"
+#include "vm.h"
+
+#include PIET_EMBEDDED
+
+#include <cstdint>
+
+// Runs the Program compiled into the executable the way piet runs an image by default: fused and propagated bytecode on the JIT with 32 bit cells
+int main() {
+	const Program program(nullptr, BLOCK_COUNT, SUCCESSORS, OPCODES, SIZES, COLORS);
+	const Bytecode bytecode = propagate(fuse(compile(program)));
+	
+	VM<std::int32_t> vm;
+	vm.block = program.start();
+	
+	run_jit(bytecode, vm);
+	
+	return 0;
+}
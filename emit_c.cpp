@@ -0,0 +1,211 @@
+#include "emit_c.h"
+
+#include <string>
+#include <vector>
+
+// Arithmetic goes through unsigned so that overflow wraps like it does in the interpreter instead of being undefined
+const char* const prelude = R"(#include <stdio.h>
+#include <stdlib.h>
+
+static inline int* grow(int* stack, size_t* capacity) {
+	*capacity = *capacity ? *capacity * 2 : 64;
+	stack = realloc(stack, *capacity * sizeof(int));
+	
+	if(!stack) abort();
+	
+	return stack;
+}
+
+static inline void reverse(int* first, int* last) {
+	while(first < --last) {
+		int value = *first;
+		*first++ = *last;
+		*last = value;
+	}
+}
+
+static inline void roll(int* stack, size_t* size) {
+	if(*size < 2) return;
+	
+	int b = stack[*size - 1];
+	int a = stack[*size - 2];
+	
+	if(a < 0 || (size_t) a > *size - 2) return;
+	
+	*size -= 2;
+	
+	if(a > 0) {
+		int* last = stack + *size;
+		int* middle = last - (b % a + a) % a;
+		
+		reverse(last - a, middle);
+		reverse(middle, last);
+		reverse(last - a, last);
+	}
+}
+
+#define PUSH(value) do { int pushed = (value); if(size == capacity) stack = grow(stack, &capacity); stack[size++] = pushed; } while(0)
+#define BINARY(expression) do { if(size >= 2) { int a = stack[size - 2], b = stack[size - 1]; size--; stack[size - 1] = (expression); } } while(0)
+
+int main(void) {
+	int* stack = NULL;
+	size_t size = 0;
+	size_t capacity = 0;
+	int popped;
+
+)";
+
+std::string label(Location location) {
+	return "b" + std::to_string(location / 8) + "_dp" + std::to_string(location / 2 % 4) + "_cc" + std::to_string(location % 2);
+}
+
+// Locations a POINTER or SWITCH can continue at, the first one being where it goes when the stack is empty
+std::vector<Location> successors(const Instruction& instruction) {
+	const Location location = instruction.operand;
+	const unsigned block = location / 8;
+	const unsigned dp = location / 2 % 4;
+	const unsigned cc = location % 2;
+	
+	std::vector<Location> locations = {location};
+	
+	if(instruction.op == POINTER) {
+		for(unsigned d = 0; d < 4; d++) {
+			locations.push_back(block * 8 + d * 2 + cc);
+		}
+	} else {
+		for(unsigned c = 0; c < 2; c++) {
+			locations.push_back(block * 8 + dp * 2 + c);
+		}
+	}
+	
+	return locations;
+}
+
+void emit_c(const Bytecode& bytecode, std::ostream& out, const char* source) {
+	const std::vector<Instruction>& code = bytecode.instructions();
+	
+	// Several Locations can share code, jumps go to the first one that starts at an address
+	std::vector<Location> names(code.size(), UNCOMPILED);
+	std::vector<bool> targets(code.size(), false);
+	
+	for(Location location = 0; location < bytecode.locations(); location++) {
+		const std::uint32_t pc = bytecode.entry(location);
+		
+		if(pc != UNCOMPILED && names[pc] == UNCOMPILED) {
+			names[pc] = location;
+		}
+	}
+	
+	for(const Instruction& instruction : code) {
+		if(instruction.op == JUMP || instruction.op == BRANCH_IMMEDIATE) {
+			targets[instruction.operand] = true;
+		} else if(instruction.op == POINTER || instruction.op == SWITCH) {
+			for(const Location location : successors(instruction)) {
+				targets[bytecode.entry(location)] = true;
+			}
+		}
+	}
+	
+	out << "/* Generated by piet --emit-c from " << source << " */\n\n" << prelude;
+	
+	for(std::uint32_t pc = 0; pc < code.size(); pc++) {
+		const Instruction& instruction = code[pc];
+		
+		if(targets[pc]) {
+			out << label(names[pc]) << ":\n";
+		}
+		
+		out << "\t";
+		
+		switch(instruction.op) {
+			case PUSH:
+				out << "PUSH(" << instruction.operand << ");\n";
+				break;
+			case POP:
+				out << "if(size >= 1) size--;\n";
+				break;
+			case ADD:
+				out << "BINARY((int) ((unsigned) a + (unsigned) b));\n";
+				break;
+			case SUBTRACT:
+				out << "BINARY((int) ((unsigned) a - (unsigned) b));\n";
+				break;
+			case MULTIPLY:
+				out << "BINARY((int) ((unsigned) a * (unsigned) b));\n";
+				break;
+			case DIVIDE:
+				out << "if(size >= 2 && stack[size - 1] != 0) BINARY(a / b);\n";
+				break;
+			case MOD:
+				out << "if(size >= 2 && stack[size - 1] != 0) BINARY(a % b != 0 && (a % b < 0) != (b < 0) ? a % b + b : a % b);\n";
+				break;
+			case NOT:
+				out << "if(size >= 1) stack[size - 1] = !stack[size - 1];\n";
+				break;
+			case GREATER:
+				out << "BINARY(a > b);\n";
+				break;
+			case DUPLICATE:
+				out << "if(size >= 1) PUSH(stack[size - 1]);\n";
+				break;
+			case ROLL:
+				out << "roll(stack, &size);\n";
+				break;
+			case ADD_IMMEDIATE:
+				out << "if(size >= 1) stack[size - 1] = (int) ((unsigned) stack[size - 1] + " << instruction.operand << "u); else PUSH(" << instruction.operand << ");\n";
+				break;
+			case SUBTRACT_IMMEDIATE:
+				out << "if(size >= 1) stack[size - 1] = (int) ((unsigned) stack[size - 1] - " << instruction.operand << "u); else PUSH(" << instruction.operand << ");\n";
+				break;
+			case MULTIPLY_IMMEDIATE:
+				out << "if(size >= 1) stack[size - 1] = (int) ((unsigned) stack[size - 1] * " << instruction.operand << "u); else PUSH(" << instruction.operand << ");\n";
+				break;
+			case SQUARE:
+				out << "if(size >= 1) stack[size - 1] = (int) ((unsigned) stack[size - 1] * (unsigned) stack[size - 1]);\n";
+				break;
+			case ROLL_IMMEDIATE:
+				out << "PUSH(" << (instruction.operand >> 16) << "); PUSH(" << (instruction.operand & 0xFFFF) << "); roll(stack, &size);\n";
+				break;
+			case IN_NUMBER:
+				out << "{ int value = 0; if(scanf(\"%d\", &value) != 1) value = 0; PUSH(value); }\n";
+				break;
+			case IN_CHAR:
+				out << "{ char value = 0; if(scanf(\" %c\", &value) != 1) value = 0; PUSH(value); }\n";
+				break;
+			case OUT_NUMBER:
+				out << "if(size >= 1) printf(\"%d\", stack[--size]);\n";
+				break;
+			case OUT_CHAR:
+				out << "if(size >= 1) putchar((char) stack[--size]);\n";
+				break;
+			case POINTER:
+			case SWITCH: {
+				const std::vector<Location> locations = successors(instruction);
+				
+				out << "if(size < 1) goto " << label(names[bytecode.entry(locations[0])]) << ";\n";
+				out << "\tpopped = stack[--size];\n";
+				
+				if(instruction.op == POINTER) {
+					out << "\tswitch(((unsigned) popped + " << instruction.operand / 2 % 4 << ") & 3) {\n";
+				} else {
+					out << "\tswitch(((unsigned) popped + " << instruction.operand % 2 << ") & 1) {\n";
+				}
+				
+				for(std::size_t i = 1; i < locations.size(); i++) {
+					out << "\t\tcase " << i - 1 << ": goto " << label(names[bytecode.entry(locations[i])]) << ";\n";
+				}
+				
+				out << "\t}\n";
+				break;
+			}
+			case JUMP:
+			case BRANCH_IMMEDIATE:
+				out << "goto " << label(names[instruction.operand]) << ";\n";
+				break;
+			default:
+				out << "free(stack);\n\treturn 0;\n";
+		}
+	}
+	
+	out << "}\n";
+}
@@ -0,0 +1,11 @@
+#ifndef PIET_EMIT_C_H
+#define PIET_EMIT_C_H
+
+#include "bytecode.h"
+
+#include <ostream>
+
+// Writes a standalone C translation unit that does what the bytecode does. Every (block, dp, cc) that code jumps to gets a label, instructions become inline stack operations and control flow becomes goto
+void emit_c(const Bytecode& bytecode, std::ostream& out, const char* source);
+
+#endif //PIET_EMIT_C_H
@@ -0,0 +1,56 @@
+#include "emit_header.h"
+
+// Spelled like the enumerators, so the header reads like the Opcode table
+const char* const opcode_names[BLOCKED + 1] = {
+		"SKIP", "ADD", "DIVIDE", "GREATER", "DUPLICATE", "IN_CHAR",
+		"PUSH", "SUBTRACT", "MOD", "POINTER", "ROLL", "OUT_NUMBER",
+		"POP", "MULTIPLY", "NOT", "SWITCH", "IN_NUMBER", "OUT_CHAR",
+		"BLOCKED"
+};
+
+void emit_header(const Program& program, std::ostream& out, const char* source) {
+	const unsigned count = program.block_count();
+	
+	out << "// Generated by piet --emit-header from " << source << "\n\n";
+	out << "#include \"program.h\"\n\n";
+	out << "constexpr unsigned BLOCK_COUNT = " << count << ";\n\n";
+	
+	// One line per block
+	out << "constexpr std::uint32_t SUCCESSORS[] = {\n";
+	
+	for(unsigned block = 0; block < count; block++) {
+		out << "\t";
+		
+		for(unsigned exit = 0; exit < 8; exit++) {
+			out << program.successor(block, exit) << (exit < 7 ? ", " : ",");
+		}
+		
+		out << "\n";
+	}
+	
+	out << "};\n\nconstexpr Opcode OPCODES[] = {\n";
+	
+	for(unsigned block = 0; block < count; block++) {
+		out << "\t";
+		
+		for(unsigned exit = 0; exit < 8; exit++) {
+			out << opcode_names[program.opcode(block, exit)] << (exit < 7 ? ", " : ",");
+		}
+		
+		out << "\n";
+	}
+	
+	out << "};\n\nconstexpr std::uint32_t SIZES[] = {";
+	
+	for(unsigned block = 0; block < count; block++) {
+		out << (block % 16 == 0 ? "\n\t" : " ") << program.block_size(block) << ",";
+	}
+	
+	out << "\n};\n\nconstexpr unsigned char COLORS[] = {";
+	
+	for(unsigned block = 0; block < count; block++) {
+		out << (block % 16 == 0 ? "\n\t" : " ") << static_cast<unsigned>(program.color(block)) << ",";
+	}
+	
+	out << "\n};\n";
+}
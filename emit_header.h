@@ -0,0 +1,11 @@
+#ifndef PIET_EMIT_HEADER_H
+#define PIET_EMIT_HEADER_H
+
+#include "program.h"
+
+#include <ostream>
+
+// Writes a header that holds the Program as constexpr arrays, named like its fields in upper case, so an executable built with it needs neither the image nor a load phase
+void emit_header(const Program& program, std::ostream& out, const char* source);
+
+#endif //PIET_EMIT_HEADER_H
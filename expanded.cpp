@@ -0,0 +1,161 @@
+#include "expanded.h"
+
+#include "handlers.h"
+
+// For every node the first node along its chain of skips that does something, each chain walked once. A chain that ends in a cycle of skips never gets anywhere, so its nodes are kept as they are
+std::vector<std::uint32_t> forward(const std::vector<Node>& nodes) {
+	enum Mark : unsigned char {UNVISITED, VISITING, DONE};
+	
+	std::vector<std::uint32_t> targets(nodes.size());
+	std::vector<Mark> marks(nodes.size(), UNVISITED);
+	std::vector<std::uint32_t> path;
+	
+	for(std::uint32_t index = 0; index < nodes.size(); index++) {
+		std::uint32_t current = index;
+		
+		while(marks[current] == UNVISITED && nodes[current].opcode == SKIP) {
+			marks[current] = VISITING;
+			path.push_back(current);
+			current = nodes[current].successor;
+		}
+		
+		if(marks[current] == UNVISITED) {
+			targets[current] = current;
+			marks[current] = DONE;
+		}
+		
+		// Running into the chain being walked, or into one that already turned out to loop, leaves it looping as well
+		const std::uint32_t target = marks[current] == VISITING ? current : targets[current];
+		const bool cycle = nodes[target].opcode == SKIP;
+		
+		for(const std::uint32_t node : path) {
+			targets[node] = cycle ? node : target;
+			marks[node] = DONE;
+		}
+		
+		path.clear();
+	}
+	
+	return targets;
+}
+
+Expanded::Expanded(const Program& program) : nodes(program.block_count() * 8) {
+	for(unsigned block = 0; block < program.block_count(); block++) {
+		for(unsigned exit = 0; exit < 8; exit++) {
+			Node& node = nodes[block * 8 + exit];
+			short dp = exit / 2;
+			short cc = exit % 2;
+			
+			if(program.color(block) == BLACK || !resolve(program, block, dp, cc)) {
+				node = {static_cast<std::uint32_t>(block * 8 + exit), 0, BLOCKED};
+				continue;
+			}
+			
+			const unsigned taken = dp * 2 + cc;
+			
+			node = {program.successor(block, taken) * 8 + taken, program.block_size(block), program.opcode(block, taken)};
+		}
+	}
+	
+	const std::vector<std::uint32_t> targets = forward(nodes);
+	
+	// A direction change picks its node at runtime, so its successor stays the one it enters
+	for(Node& node : nodes) {
+		if(node.opcode != POINTER && node.opcode != SWITCH) {
+			node.successor = targets[node.successor];
+		}
+	}
+	
+	entry = targets[program.start() * 8];
+}
+
+std::size_t Expanded::reachable() const {
+	std::vector<bool> seen(nodes.size(), false);
+	std::vector<std::uint32_t> pending = {entry};
+	std::size_t count = 0;
+	
+	seen[entry] = true;
+	
+	while(!pending.empty()) {
+		const std::uint32_t index = pending.back();
+		pending.pop_back();
+		
+		count++;
+		
+		const Node& node = nodes[index];
+		
+		if(node.opcode == BLOCKED) continue;
+		
+		std::vector<std::uint32_t> next = {node.successor};
+		
+		// The direction change decides which of the nodes of the successor block comes next
+		const std::uint32_t block = node.successor / 8;
+		const unsigned dp = node.successor / 2 % 4;
+		const unsigned cc = node.successor % 2;
+		
+		if(node.opcode == POINTER) {
+			for(unsigned d = 0; d < 4; d++) {
+				next.push_back(block * 8 + d * 2 + cc);
+			}
+		} else if(node.opcode == SWITCH) {
+			for(unsigned c = 0; c < 2; c++) {
+				next.push_back(block * 8 + dp * 2 + c);
+			}
+		}
+		
+		for(const std::uint32_t n : next) {
+			if(!seen[n]) {
+				seen[n] = true;
+				pending.push_back(n);
+			}
+		}
+	}
+	
+	return count;
+}
+
+void Expanded::report(std::ostream& out, const Program& program) const {
+	const std::size_t graph = program.block_count() * (8 * sizeof(std::uint32_t) + 8 * sizeof(Opcode) + sizeof(std::uint32_t) + 1);
+	const std::size_t expanded = nodes.size() * sizeof(Node);
+	
+	out << "blocks: " << program.block_count() << ", " << graph << " bytes\n";
+	out << "expanded nodes: " << nodes.size() << " (" << reachable() << " reachable), " << expanded << " bytes\n";
+}
+
+template<typename Cell>
+void run(const Expanded& expanded, VM<Cell>& vm) {
+	std::uint32_t index = expanded.start();
+	
+	try {
+		while(true) {
+			const Node& node = expanded.node(index);
+			
+			count(vm, node.opcode != SKIP && node.opcode != BLOCKED);
+			
+			switch(node.opcode) {
+				case BLOCKED:
+					return;
+				case POINTER:
+				case SWITCH:
+					vm.dp = node.successor / 2 % 4;
+					vm.cc = node.successor % 2;
+					
+					commands<Cell>[node.opcode](vm, 0);
+					
+					// Lands on a skip at worst, which just moves on
+					index = node.successor / 8 * 8 + vm.dp * 2 + vm.cc;
+					break;
+				default:
+					commands<Cell>[node.opcode](vm, node.operand);
+					index = node.successor;
+			}
+		}
+	} catch(const Overflow&) {
+		vm.block = index / 8;
+		throw;
+	}
+}
+
+#define INSTANTIATE(Cell) template void run(const Expanded& expanded, VM<Cell>& vm);
+
+PIET_CELLS(INSTANTIATE)
@@ -0,0 +1,51 @@
+#ifndef PIET_EXPANDED_H
+#define PIET_EXPANDED_H
+
+#include "program.h"
+#include "vm.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// One node per (block, dp, cc), numbered block * 8 + dp * 2 + cc. Retries and white blocks are folded in, so a node only has to do its opcode and move on. BLOCKED marks a node where the program ends
+struct Node {
+	std::uint32_t successor;    // For POINTER and SWITCH the node entered before the direction changes
+	std::uint32_t operand;      // Size of the block being left
+	Opcode opcode;
+};
+
+// The block graph expanded over every direction it can be left in, up to 8 times its size
+class Expanded {
+public:
+	explicit Expanded(const Program& program);
+	
+	const Node& node(std::uint32_t index) const {
+		return nodes[index];
+	}
+	
+	std::uint32_t start() const {
+		return entry;
+	}
+	
+	std::size_t node_count() const {
+		return nodes.size();
+	}
+	
+	// Nodes that can be reached from the start
+	std::size_t reachable() const;
+	
+	// Compares the memory of the expanded graph to that of the Program it came from
+	void report(std::ostream& out, const Program& program) const;
+
+private:
+	std::vector<Node> nodes;
+	std::uint32_t entry;
+};
+
+// Runs until the program terminates
+template<typename Cell>
+void run(const Expanded& expanded, VM<Cell>& vm);
+
+#endif //PIET_EXPANDED_H
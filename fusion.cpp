@@ -0,0 +1,231 @@
+#include "fusion.h"
+
+#include <algorithm>
+#include <utility>
+
+const std::vector<Fusion> fusions = {
+		{"push push roll", {PUSH, PUSH, ROLL}, ROLL_IMMEDIATE},
+		{"push add", {PUSH, ADD}, ADD_IMMEDIATE},
+		{"push subtract", {PUSH, SUBTRACT}, SUBTRACT_IMMEDIATE},
+		{"push multiply", {PUSH, MULTIPLY}, MULTIPLY_IMMEDIATE},
+		{"push pointer", {PUSH, POINTER}, BRANCH_IMMEDIATE},
+		{"push switch", {PUSH, SWITCH}, BRANCH_IMMEDIATE},
+		{"duplicate multiply", {DUPLICATE, MULTIPLY}, SQUARE}
+};
+
+// Builds the instruction replacing a match, returns false if the operands do not fit in it
+bool combine(const Bytecode& bytecode, const Fusion& fusion, const Instruction* match, Instruction& fused) {
+	fused.op = fusion.op;
+	
+	switch(fusion.op) {
+		case ROLL_IMMEDIATE:
+			if(match[0].operand > 0xFFFF || match[1].operand > 0xFFFF) return false;
+			
+			fused.operand = match[0].operand << 16 | match[1].operand;
+			return true;
+		case BRANCH_IMMEDIATE: {
+			// The pushed size is what gets popped, so the new direction is known
+			const Location location = match[1].operand;
+			const unsigned block = location / 8;
+			unsigned dp = location / 2 % 4;
+			unsigned cc = location % 2;
+			
+			if(match[1].op == POINTER) {
+				dp = (dp + match[0].operand) % 4;
+			} else {
+				cc = (cc + match[0].operand) % 2;
+			}
+			
+			fused.operand = bytecode.entry(block * 8 + dp * 2 + cc);
+			return fused.operand != UNCOMPILED;
+		}
+		case SQUARE:
+			fused.operand = 0;
+			return true;
+		default:
+			fused.operand = match[0].operand;
+			return true;
+	}
+}
+
+Bytecode fuse(const Bytecode& bytecode, FusionReport* report) {
+	const std::vector<Instruction>& code = bytecode.instructions();
+	
+	if(report) {
+		report->assign(fusions.size(), 0);
+	}
+	
+	// Addresses that are entered other than by falling through, a pattern may only start at one of these
+	std::vector<bool> targets(code.size(), false);
+	
+	targets[bytecode.start()] = true;
+	
+	for(const Instruction& instruction : code) {
+		if(instruction.op == JUMP || instruction.op == BRANCH_IMMEDIATE) {
+			targets[instruction.operand] = true;
+		} else if(instruction.op == POINTER || instruction.op == SWITCH) {
+			const unsigned block = instruction.operand / 8;
+			
+			for(unsigned exit = 0; exit < 8; exit++) {
+				const std::uint32_t pc = bytecode.entry(block * 8 + exit);
+				
+				if(pc != UNCOMPILED) {
+					targets[pc] = true;
+				}
+			}
+		}
+	}
+	
+	std::vector<Instruction> fused;
+	std::vector<std::uint32_t> blocks;
+	std::vector<std::uint32_t> addresses(code.size(), UNCOMPILED);
+	
+	for(std::uint32_t pc = 0; pc < code.size();) {
+		addresses[pc] = fused.size();
+		
+		std::size_t length = 1;
+		Instruction instruction = code[pc];
+		
+		for(std::size_t i = 0; i < fusions.size() && length == 1; i++) {
+			const std::vector<unsigned char>& sequence = fusions[i].sequence;
+			
+			if(pc + sequence.size() > code.size()) continue;
+			
+			bool match = true;
+			
+			for(std::size_t j = 0; j < sequence.size() && match; j++) {
+				match = code[pc + j].op == sequence[j] && (j == 0 || !targets[pc + j]);
+			}
+			
+			if(match && combine(bytecode, fusions[i], &code[pc], instruction)) {
+				length = sequence.size();
+				
+				if(report) {
+					(*report)[i]++;
+				}
+			}
+		}
+		
+		// Only the last command of a superinstruction can overflow, so that is the block it is reported in
+		fused.push_back(instruction);
+		blocks.push_back(bytecode.block(pc + length - 1));
+		pc += length;
+	}
+	
+	// Jumps still point at old addresses, including the ones that were just made
+	for(Instruction& instruction : fused) {
+		if(instruction.op == JUMP || instruction.op == BRANCH_IMMEDIATE) {
+			instruction.operand = addresses[instruction.operand];
+		}
+	}
+	
+	std::vector<std::uint32_t> entries(bytecode.locations());
+	
+	for(Location location = 0; location < bytecode.locations(); location++) {
+		const std::uint32_t pc = bytecode.entry(location);
+		
+		entries[location] = pc == UNCOMPILED ? UNCOMPILED : addresses[pc];
+	}
+	
+	return Bytecode(std::move(fused), std::move(entries), std::move(blocks));
+}
+
+Profile::Profile()
+		: executed(INSTRUCTION_COUNT), pairs(INSTRUCTION_COUNT * INSTRUCTION_COUNT), triples(INSTRUCTION_COUNT * INSTRUCTION_COUNT * INSTRUCTION_COUNT) {}
+
+void Profile::record(unsigned char op) {
+	executed[op]++;
+	
+	if(second != INSTRUCTION_COUNT) {
+		pairs[second * INSTRUCTION_COUNT + op]++;
+		
+		if(first != INSTRUCTION_COUNT) {
+			triples[(first * INSTRUCTION_COUNT + second) * INSTRUCTION_COUNT + op]++;
+		}
+	}
+	
+	first = second;
+	second = op;
+}
+
+void Profile::interrupt() {
+	first = INSTRUCTION_COUNT;
+	second = INSTRUCTION_COUNT;
+}
+
+// Writes the count most frequent sequences of length instructions
+void write_hottest(std::ostream& out, const std::vector<std::uint64_t>& counts, unsigned length, unsigned count) {
+	std::vector<std::pair<std::uint64_t, unsigned>> hottest;
+	
+	for(unsigned i = 0; i < counts.size(); i++) {
+		if(counts[i]) {
+			hottest.emplace_back(counts[i], i);
+		}
+	}
+	
+	std::sort(hottest.begin(), hottest.end(), [](const std::pair<std::uint64_t, unsigned>& a, const std::pair<std::uint64_t, unsigned>& b) {
+		return a.first > b.first || (a.first == b.first && a.second < b.second);
+	});
+	
+	if(hottest.size() > count) {
+		hottest.resize(count);
+	}
+	
+	for(auto& sequence : hottest) {
+		out << "  " << sequence.first << "\t";
+		
+		unsigned index = sequence.second;
+		std::vector<unsigned char> ops(length);
+		
+		for(unsigned i = length; i > 0; i--) {
+			ops[i - 1] = index % INSTRUCTION_COUNT;
+			index /= INSTRUCTION_COUNT;
+		}
+		
+		for(unsigned i = 0; i < length; i++) {
+			out << (i ? " " : "") << instruction_name(ops[i]);
+		}
+		
+		out << "\n";
+	}
+}
+
+void Profile::write(std::ostream& out, const FusionReport& report, unsigned count) const {
+	out << "fusions:\n";
+	
+	for(std::size_t i = 0; i < fusions.size(); i++) {
+		out << "  " << (i < report.size() ? report[i] : 0) << "\t" << fusions[i].name << "\n";
+	}
+	
+	out << "superinstructions executed:\n";
+	
+	for(unsigned op = HALT + 1; op < INSTRUCTION_COUNT; op++) {
+		out << "  " << executed[op] << "\t" << instruction_name(op) << "\n";
+	}
+	
+	out << "hottest pairs:\n";
+	write_hottest(out, pairs, 2, count);
+	out << "hottest triples:\n";
+	write_hottest(out, triples, 3, count);
+}
+
+template<typename Cell>
+void run_profiled(const Bytecode& bytecode, VM<Cell>& vm, Profile& profile) {
+	const std::vector<Instruction>& code = bytecode.instructions();
+	
+	for(std::uint32_t pc = bytecode.start(); pc != UNCOMPILED;) {
+		const unsigned char op = code[pc].op;
+		
+		profile.record(op);
+		
+		pc = step(bytecode, vm, pc);
+		
+		if(op == JUMP || op == BRANCH_IMMEDIATE || op == POINTER || op == SWITCH) {
+			profile.interrupt();
+		}
+	}
+}
+
+#define INSTANTIATE(Cell) template void run_profiled(const Bytecode& bytecode, VM<Cell>& vm, Profile& profile);
+
+PIET_CELLS(INSTANTIATE)
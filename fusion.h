@@ -0,0 +1,52 @@
+#ifndef PIET_FUSION_H
+#define PIET_FUSION_H
+
+#include "bytecode.h"
+#include "vm.h"
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// A sequence of instructions that is replaced by a single one. Fusions that resolve a POINTER or SWITCH become a BRANCH_IMMEDIATE
+struct Fusion {
+	const char* name;
+	std::vector<unsigned char> sequence;
+	unsigned char op;
+};
+
+// Tried in order at every address, longest first
+extern const std::vector<Fusion> fusions;
+
+// Number of times each fusion fired, indexed like fusions
+typedef std::vector<unsigned> FusionReport;
+
+// Replaces the patterns in fusions wherever none of the instructions but the first can be jumped to
+Bytecode fuse(const Bytecode& bytecode, FusionReport* report = nullptr);
+
+// What ran and what ran back to back. Sequences never span control flow, so the hottest ones are the candidates for new fusions
+class Profile {
+public:
+	Profile();
+	
+	void record(unsigned char op);
+	
+	// Control flow ends a sequence
+	void interrupt();
+	
+	// Writes the fusions that fired, how often the superinstructions ran and the hottest sequences of two and three instructions
+	void write(std::ostream& out, const FusionReport& report, unsigned count = 10) const;
+
+private:
+	std::vector<std::uint64_t> executed;
+	std::vector<std::uint64_t> pairs;
+	std::vector<std::uint64_t> triples;
+	unsigned first = INSTRUCTION_COUNT;
+	unsigned second = INSTRUCTION_COUNT;
+};
+
+// Interprets one instruction at a time, recording everything that runs
+template<typename Cell>
+void run_profiled(const Bytecode& bytecode, VM<Cell>& vm, Profile& profile);
+
+#endif //PIET_FUSION_H
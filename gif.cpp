@@ -0,0 +1,176 @@
+#include "gif.h"
+
+#include "classify.h"
+#include "program.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+// Little endian integer of two bytes
+std::uint32_t short_little(const unsigned char* bytes) {
+	return bytes[0] | bytes[1] << 8;
+}
+
+Gif::Gif(const char* image, int codel_size) : file(image, std::ios::binary), block(0), ended(false), codel_size(codel_size), decoded(0), palette() {
+	unsigned char screen[13];
+	
+	if(!file) {
+		throw std::runtime_error(std::string("cannot open ") + image);
+	}
+	
+	if(!file.read(reinterpret_cast<char*>(screen), 13) || (std::memcmp(screen, "GIF87a", 6) != 0 && std::memcmp(screen, "GIF89a", 6) != 0)) {
+		throw std::runtime_error(std::string(image) + " is not a gif");
+	}
+	
+	// Palette entries are red, green and blue. Indices past the end of a palette are black
+	unsigned char entries[3 * 256];
+	unsigned char global[256];
+	
+	std::fill(global, global + 256, BLACK);
+	
+	if(screen[10] & 0x80) {
+		const int count = 2 << (screen[10] & 7);
+		
+		if(!file.read(reinterpret_cast<char*>(entries), 3 * count)) {
+			throw std::runtime_error(std::string(image) + " is truncated");
+		}
+		
+		for(int i = 0; i < count; i++) {
+			global[i] = classify(entries[3 * i], entries[3 * i + 1], entries[3 * i + 2]);
+		}
+	}
+	
+	background = global[screen[11]];
+	std::copy(global, global + 256, palette);
+	
+	// Extensions before the first frame say nothing about its pixels
+	while(true) {
+		const int introducer = file.get();
+		
+		if(introducer == 0x2C) break;
+		
+		if(introducer != 0x21 || file.get() == EOF) {
+			throw std::runtime_error(std::string(image) + (introducer == 0x3B ? " has no frames" : " is corrupt"));
+		}
+		
+		for(int size = file.get(); size > 0; size = file.get()) {
+			file.seekg(size, std::ios::cur);
+		}
+	}
+	
+	unsigned char descriptor[9];
+	
+	if(!file.read(reinterpret_cast<char*>(descriptor), 9)) {
+		throw std::runtime_error(std::string(image) + " is truncated");
+	}
+	
+	left = short_little(&descriptor[0]);
+	top = short_little(&descriptor[2]);
+	frame_width = short_little(&descriptor[4]);
+	frame_height = short_little(&descriptor[6]);
+	interlaced = descriptor[8] & 0x40;
+	
+	if(descriptor[8] & 0x80) {
+		const int count = 2 << (descriptor[8] & 7);
+		
+		if(!file.read(reinterpret_cast<char*>(entries), 3 * count)) {
+			throw std::runtime_error(std::string(image) + " is truncated");
+		}
+		
+		std::fill(palette, palette + 256, BLACK);
+		
+		for(int i = 0; i < count; i++) {
+			palette[i] = classify(entries[3 * i], entries[3 * i + 1], entries[3 * i + 2]);
+		}
+	}
+	
+	lzw.reset(new Lzw(file.get(), [this](unsigned char* buffer, std::size_t capacity) { return compressed(buffer, capacity); }));
+	line.resize(frame_width);
+	
+	columns = short_little(&screen[6]) / codel_size;
+	rows = short_little(&screen[8]) / codel_size;
+}
+
+std::size_t Gif::compressed(unsigned char* buffer, std::size_t capacity) {
+	if(block == 0) {
+		const int size = ended ? 0 : file.get();
+		
+		if(size == EOF) {
+			throw std::runtime_error("image data is truncated");
+		}
+		
+		// An empty sub-block ends the frame
+		if(size == 0) {
+			ended = true;
+			return 0;
+		}
+		
+		block = size;
+	}
+	
+	const std::size_t size = std::min<std::size_t>(capacity, block);
+	
+	if(!file.read(reinterpret_cast<char*>(buffer), size)) {
+		throw std::runtime_error("image data is truncated");
+	}
+	
+	block -= size;
+	
+	return size;
+}
+
+void Gif::convert(unsigned char* colors) const {
+	for(int x = 0; x < columns; x++) {
+		const std::uint64_t pixel = static_cast<std::uint64_t>(x) * codel_size;
+		
+		colors[x] = pixel >= left && pixel - left < frame_width ? palette[line[pixel - left]] : background;
+	}
+}
+
+void Gif::deinterlace() {
+	// Where the rows of each pass start and how far apart they are
+	const int starts[4] = {0, 4, 2, 1};
+	const int steps[4] = {8, 8, 4, 2};
+	
+	codes.assign(static_cast<std::size_t>(columns) * rows, background);
+	
+	for(int pass = 0; pass < 4; pass++) {
+		for(std::uint32_t j = starts[pass]; j < frame_height; j += steps[pass]) {
+			lzw->read(line.data(), frame_width);
+			
+			const std::uint32_t y = top + j;
+			
+			if(y % codel_size == static_cast<std::uint32_t>(codel_size - 1) && y / codel_size < static_cast<std::uint32_t>(rows)) {
+				convert(&codes[y / codel_size * columns]);
+			}
+		}
+	}
+}
+
+void Gif::row(int y, unsigned char* colors) {
+	if(interlaced) {
+		if(decoded == 0) {
+			deinterlace();
+			decoded = frame_height;
+		}
+		
+		std::copy(codes.begin() + static_cast<std::size_t>(y) * columns, codes.begin() + static_cast<std::size_t>(y + 1) * columns, colors);
+		return;
+	}
+	
+	const std::uint32_t pixel = static_cast<std::uint32_t>(y) * codel_size + codel_size - 1;
+	
+	if(pixel < top || pixel - top >= frame_height) {
+		std::fill(colors, colors + columns, background);
+		return;
+	}
+	
+	while(decoded <= pixel - top) {
+		lzw->read(line.data(), frame_width);
+		decoded++;
+	}
+	
+	convert(colors);
+}
@@ -0,0 +1,48 @@
+#ifndef PIET_GIF_H
+#define PIET_GIF_H
+
+#include "image.h"
+#include "lzw.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+// A gif file decompressed while its rows are read, keeping one pixel row. Only the first frame is used, the screen around it has the background color. Interlaced frames store their rows in four passes, so those are decoded in one go into a color per codel. Throws std::runtime_error for anything it cannot read
+class Gif : public Image {
+public:
+	Gif(const char* image, int codel_size);
+	
+	void row(int y, unsigned char* colors) override;
+
+private:
+	// Compressed data from the sub-blocks of the frame
+	std::size_t compressed(unsigned char* buffer, std::size_t capacity);
+	
+	// Classifies the codels of the frame row in line, codels left or right of the frame get the background
+	void convert(unsigned char* colors) const;
+	
+	void deinterlace();
+	
+	std::ifstream file;
+	unsigned block;         // Bytes left in the current sub-block
+	bool ended;             // Past the last sub-block
+	std::unique_ptr<Lzw> lzw;
+	
+	int codel_size;
+	std::uint32_t left;     // Of the frame on the screen
+	std::uint32_t top;
+	std::uint32_t frame_width;
+	std::uint32_t frame_height;
+	bool interlaced;
+	
+	std::vector<unsigned char> line;
+	std::uint32_t decoded;  // Frame rows so far
+	unsigned char palette[256];    // Color code of every palette entry
+	unsigned char background;
+	std::vector<unsigned char> codes;    // Of every codel of an interlaced frame
+};
+
+#endif //PIET_GIF_H
@@ -0,0 +1,281 @@
+#ifndef PIET_HANDLERS_H
+#define PIET_HANDLERS_H
+
+#include "cell.h"
+#include "vm.h"
+
+#include <cstdint>
+#include <iostream>
+#include <utility>
+
+// Defined inline so that the interpreter cores can inline them instead of calling through the commands table. Each works for any cell type
+
+template<typename Cell>
+inline void skip(VM<Cell>& vm, std::uint32_t operand) {
+	// ¯\_(ツ)_/¯
+}
+
+template<typename Cell>
+inline void push(VM<Cell>& vm, std::uint32_t operand) {
+	Cell a = static_cast<std::int32_t>(operand);
+	
+	vm.stack.push(a);
+}
+
+template<typename Cell>
+inline void pop(VM<Cell>& vm, std::uint32_t operand) {
+	if(vm.stack.empty()) return;
+	
+	vm.stack.pop();
+}
+
+template<typename Cell>
+inline void add(VM<Cell>& vm, std::uint32_t operand) {
+	if(vm.stack.size() < 2) return;
+	
+	Cell b = std::move(vm.stack.top());
+	vm.stack.pop();
+	
+	Cell a = std::move(vm.stack.top());
+	vm.stack.pop();
+	
+	vm.stack.push(a + b);
+}
+
+template<typename Cell>
+inline void subtract(VM<Cell>& vm, std::uint32_t operand) {
+	if(vm.stack.size() < 2) return;
+	
+	Cell b = std::move(vm.stack.top());
+	vm.stack.pop();
+	
+	Cell a = std::move(vm.stack.top());
+	vm.stack.pop();
+	
+	vm.stack.push(a - b);
+}
+
+template<typename Cell>
+inline void multiply(VM<Cell>& vm, std::uint32_t operand) {
+	if(vm.stack.size() < 2) return;
+	
+	Cell b = std::move(vm.stack.top());
+	vm.stack.pop();
+	
+	Cell a = std::move(vm.stack.top());
+	vm.stack.pop();
+	
+	vm.stack.push(a * b);
+}
+
+template<typename Cell>
+inline void divide(VM<Cell>& vm, std::uint32_t operand) {
+	if(vm.stack.size() < 2) return;
+	
+	if(vm.stack.top() == Cell(0)) return;
+	
+	Cell b = std::move(vm.stack.top());
+	vm.stack.pop();
+	
+	Cell a = std::move(vm.stack.top());
+	vm.stack.pop();
+	
+	vm.stack.push(a / b);
+}
+
+template<typename Cell>
+inline void mod(VM<Cell>& vm, std::uint32_t operand) {
+	if(vm.stack.size() < 2) return;
+	
+	if(vm.stack.top() == Cell(0)) return;
+	
+	Cell b = std::move(vm.stack.top());
+	vm.stack.pop();
+	
+	Cell a = std::move(vm.stack.top());
+	vm.stack.pop();
+	
+	Cell r = a % b;
+	
+	// Same as ((a % b) + b) % b, without the sum that can overflow
+	if(!!r && (r < Cell(0)) != (b < Cell(0))) {
+		r += b;
+	}
+	
+	vm.stack.push(std::move(r));
+}
+
+template<typename Cell>
+inline void nott(VM<Cell>& vm, std::uint32_t operand) {
+	if(vm.stack.empty()) return;
+	
+	Cell a = std::move(vm.stack.top());
+	vm.stack.pop();
+	
+	vm.stack.push(!a);
+}
+
+template<typename Cell>
+inline void greater(VM<Cell>& vm, std::uint32_t operand) {
+	if(vm.stack.size() < 2) return;
+	
+	Cell b = std::move(vm.stack.top());
+	vm.stack.pop();
+	
+	Cell a = std::move(vm.stack.top());
+	vm.stack.pop();
+	
+	vm.stack.push(a > b);
+}
+
+template<typename Cell>
+inline void pointer(VM<Cell>& vm, std::uint32_t operand) {
+	if(vm.stack.empty()) return;
+	
+	Cell a = std::move(vm.stack.top());
+	vm.stack.pop();
+	
+	vm.dp = (vm.dp + residue(a, 4)) % 4;
+}
+
+template<typename Cell>
+inline void switchh(VM<Cell>& vm, std::uint32_t operand) {
+	if(vm.stack.empty()) return;
+	
+	Cell a = std::move(vm.stack.top());
+	vm.stack.pop();
+	
+	vm.cc = (vm.cc + residue(a, 2)) % 2;
+}
+
+template<typename Cell>
+inline void duplicate(VM<Cell>& vm, std::uint32_t operand) {
+	if(vm.stack.empty()) return;
+	
+	Cell a = std::move(vm.stack.top());
+	vm.stack.pop();
+	
+	vm.stack.push(a);
+	vm.stack.push(std::move(a));
+}
+
+template<typename Cell>
+inline void roll(VM<Cell>& vm, std::uint32_t operand) {
+	if(vm.stack.size() < 2) return;
+	
+	Cell b = std::move(vm.stack.top());
+	vm.stack.pop();
+	
+	const Cell& a = vm.stack.top();
+	
+	// The depth may not reach below the bottom once it is popped itself
+	if(a < Cell(0) || a > static_cast<Cell>(static_cast<std::int64_t>(vm.stack.size()) - 1)) {
+		vm.stack.push(std::move(b));
+		return;
+	}
+	
+	const std::size_t depth = static_cast<std::int64_t>(a);
+	
+	vm.stack.pop();
+	
+	vm.stack.roll(depth, b);
+}
+
+template<typename Cell>
+inline void in_number(VM<Cell>& vm, std::uint32_t operand) {
+	Cell a = 0;
+	
+	*vm.in >> a;
+	
+	vm.stack.push(a);
+}
+
+template<typename Cell>
+inline void in_char(VM<Cell>& vm, std::uint32_t operand) {
+	char a = 0;
+	
+	*vm.in >> a;
+	
+	vm.stack.push(a);
+}
+
+template<typename Cell>
+inline void out_number(VM<Cell>& vm, std::uint32_t operand) {
+	if(vm.stack.empty()) return;
+	
+	Cell a = std::move(vm.stack.top());
+	vm.stack.pop();
+	
+	*vm.out << a;
+}
+
+template<typename Cell>
+inline void out_char(VM<Cell>& vm, std::uint32_t operand) {
+	if(vm.stack.empty()) return;
+	
+	Cell a = std::move(vm.stack.top());
+	vm.stack.pop();
+	
+	*vm.out << static_cast<char>(static_cast<std::int64_t>(a));
+}
+
+// Superinstructions, each does exactly what the sequence it replaces does
+
+template<typename Cell>
+inline void add_immediate(VM<Cell>& vm, std::uint32_t operand) {
+	if(vm.stack.empty()) {
+		vm.stack.push(operand);
+		return;
+	}
+	
+	vm.stack.top() += static_cast<std::int32_t>(operand);
+}
+
+template<typename Cell>
+inline void subtract_immediate(VM<Cell>& vm, std::uint32_t operand) {
+	if(vm.stack.empty()) {
+		vm.stack.push(operand);
+		return;
+	}
+	
+	vm.stack.top() -= static_cast<std::int32_t>(operand);
+}
+
+template<typename Cell>
+inline void multiply_immediate(VM<Cell>& vm, std::uint32_t operand) {
+	if(vm.stack.empty()) {
+		vm.stack.push(operand);
+		return;
+	}
+	
+	vm.stack.top() *= static_cast<std::int32_t>(operand);
+}
+
+template<typename Cell>
+inline void square(VM<Cell>& vm, std::uint32_t operand) {
+	if(vm.stack.empty()) return;
+	
+	vm.stack.top() *= vm.stack.top();
+}
+
+template<typename Cell>
+inline void roll_immediate(VM<Cell>& vm, std::uint32_t operand) {
+	const std::size_t a = operand >> 16;
+	const Cell b = static_cast<std::int32_t>(operand & 0xFFFF);
+	
+	if(a > vm.stack.size()) {
+		vm.stack.push(static_cast<std::int32_t>(a));
+		vm.stack.push(b);
+		return;
+	}
+	
+	vm.stack.roll(a, b);
+}
+
+// Handlers indexed by Opcode
+template<typename Cell>
+const command<Cell> commands[18] = {skip, add,      divide, greater, duplicate, in_char,
+									push, subtract, mod,    pointer, roll,      out_number,
+									pop,  multiply, nott,   switchh, in_number, out_char};
+
+#endif //PIET_HANDLERS_H
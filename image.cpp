@@ -0,0 +1,111 @@
+#include "image.h"
+
+#include "bitmap.h"
+#include "gif.h"
+#include "netpbm.h"
+#include "parallel.h"
+#include "png.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+std::unique_ptr<Image> open_image(const char* image, int codel_size) {
+	std::ifstream file(image, std::ios::binary);
+	unsigned char magic[4] = {};
+	
+	if(!file) {
+		throw std::runtime_error(std::string("cannot open ") + image);
+	}
+	
+	file.read(reinterpret_cast<char*>(magic), 4);
+	
+	if(std::memcmp(magic, "\x89PNG", 4) == 0) {
+		return std::unique_ptr<Image>(new Png(image, codel_size));
+	} else if(std::memcmp(magic, "GIF8", 4) == 0) {
+		return std::unique_ptr<Image>(new Gif(image, codel_size));
+	} else if(magic[0] == 'P' && magic[1] >= '5' && magic[1] <= '7' && std::isspace(magic[2])) {
+		return std::unique_ptr<Image>(new Netpbm(image, codel_size));
+	} else if(magic[0] == 'B' && magic[1] == 'M') {
+		return std::unique_ptr<Image>(new Bitmap(image, codel_size));
+	}
+	
+	throw std::runtime_error(std::string(image) + " is not a bmp, png, gif or binary netpbm image");
+}
+
+int gcd(int a, int b) {
+	while(b != 0) {
+		const int rest = a % b;
+		
+		a = b;
+		b = rest;
+	}
+	
+	return a;
+}
+
+// Runs start at 0 and end at the edge, so the divisor of their lengths is that of every position where the color changes together with the size of the image
+int detect_codel_size(const char* image, unsigned threads) {
+	const std::unique_ptr<Image> source = open_image(image, 1);
+	const int width = source->width();
+	const int height = source->height();
+	
+	if(width == 0 || height == 0) return 1;
+	
+	const unsigned parts = source->random_access() ? std::max(1u, std::min(threads, static_cast<unsigned>(height))) : 1;
+	
+	// Every part marks the columns where some row changes color, and the divisor of the rows where the color changes from the row above
+	std::vector<std::vector<unsigned char>> changes(parts, std::vector<unsigned char>(width, 0));
+	std::vector<int> divisors(parts, height);
+	
+	parallel(parts, [&](unsigned part) {
+		const int first = static_cast<long>(height) * part / parts;
+		const int last = static_cast<long>(height) * (part + 1) / parts;
+		
+		std::vector<unsigned char> colors(width);
+		std::vector<unsigned char> above(width);
+		unsigned char* changed = changes[part].data();
+		int& divisor = divisors[part];
+		
+		if(first > 0) {
+			source->row(first - 1, above.data());
+		}
+		
+		for(int y = first; y < last; y++) {
+			source->row(y, colors.data());
+			
+			// No branches, so this compiles to vector instructions
+			for(int x = 1; x < width; x++) {
+				changed[x] |= colors[x] != colors[x - 1];
+			}
+			
+			if(y > 0 && std::memcmp(colors.data(), above.data(), width) != 0) {
+				divisor = gcd(divisor, y);
+			}
+			
+			colors.swap(above);
+		}
+	});
+	
+	int size = height;
+	
+	for(unsigned part = 0; part < parts; part++) {
+		size = gcd(size, divisors[part]);
+	}
+	
+	size = gcd(size, width);
+	
+	for(int x = 1; x < width && size > 1; x++) {
+		for(unsigned part = 0; part < parts; part++) {
+			if(changes[part][x]) {
+				size = gcd(size, x);
+			}
+		}
+	}
+	
+	return size;
+}
@@ -0,0 +1,38 @@
+#ifndef PIET_IMAGE_H
+#define PIET_IMAGE_H
+
+#include <memory>
+
+// An image file read one codel row at a time, so the pixels never have to be in memory all at once. A codel takes the color of the pixel in the bottom left corner of its square
+class Image {
+public:
+	virtual ~Image() {}
+	
+	int width() const {
+		return columns;
+	}
+	
+	int height() const {
+		return rows;
+	}
+	
+	// Classifies codel row y into colors, row 0 being the top. Unless the image has random access, rows have to be read from top to bottom
+	virtual void row(int y, unsigned char* colors) = 0;
+	
+	// Whether rows can be read in any order and from several threads at once
+	virtual bool random_access() const {
+		return false;
+	}
+
+protected:
+	int columns = 0;
+	int rows = 0;
+};
+
+// Opens a bmp, png, gif or binary netpbm file, telling them apart by their first bytes rather than their name. Throws std::runtime_error for anything it cannot read
+std::unique_ptr<Image> open_image(const char* image, int codel_size);
+
+// The largest codel size that makes every codel one color: the greatest common divisor of the lengths of all runs of one color along rows and columns. Reads the whole image, with up to the given number of threads if it has random access. Throws std::runtime_error for anything it cannot read
+int detect_codel_size(const char* image, unsigned threads = 1);
+
+#endif //PIET_IMAGE_H
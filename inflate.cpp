@@ -0,0 +1,278 @@
+#include "inflate.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+// Base and number of extra bits of the lengths behind symbols 257 to 285, and of the distances behind the 30 distance symbols
+const std::uint16_t LENGTH_BASES[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+const unsigned char LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const std::uint16_t DISTANCE_BASES[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+const unsigned char DISTANCE_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// Order in which a dynamic block lists the lengths of the code length code
+const unsigned char LENGTH_ORDER[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+void Huffman::build(const unsigned char* lengths, int count) {
+	std::uint16_t offsets[16];
+	
+	std::fill(fast, fast + (1 << FAST_BITS), 0);
+	std::fill(counts, counts + 16, 0);
+	
+	for(int symbol = 0; symbol < count; symbol++) {
+		counts[lengths[symbol]]++;
+	}
+	
+	counts[0] = 0;
+	offsets[1] = 0;
+	
+	for(int length = 1; length < 15; length++) {
+		offsets[length + 1] = offsets[length] + counts[length];
+	}
+	
+	for(int symbol = 0; symbol < count; symbol++) {
+		if(lengths[symbol] > 0) {
+			symbols[offsets[lengths[symbol]]++] = symbol;
+		}
+	}
+	
+	// Codes are read starting from their highest bit, so the table is indexed by the code reversed
+	unsigned code = 0;
+	int index = 0;
+	
+	for(int length = 1; length <= FAST_BITS; length++) {
+		for(int i = 0; i < counts[length]; i++, index++, code++) {
+			unsigned reversed = 0;
+			
+			for(int bit = 0; bit < length; bit++) {
+				reversed |= (code >> bit & 1) << (length - 1 - bit);
+			}
+			
+			for(unsigned fill = reversed; fill < (1u << FAST_BITS); fill += 1u << length) {
+				fast[fill] = symbols[index] << 4 | length;
+			}
+		}
+		
+		code <<= 1;
+	}
+}
+
+Inflater::Inflater(std::function<std::size_t(unsigned char*, std::size_t)> refill)
+		: refill(std::move(refill)), input(1 << 16), position(0), available(0), buffer(0), held(0), written(0), started(false), last(false), mode(HEADER), remaining(0), copy_length(0), copy_distance(0) {}
+
+bool Inflater::fill(int count) {
+	while(held < count) {
+		if(position == available) {
+			position = 0;
+			available = refill(input.data(), input.size());
+			
+			if(available == 0) return false;
+		}
+		
+		buffer |= static_cast<std::uint64_t>(input[position++]) << held;
+		held += 8;
+	}
+	
+	return true;
+}
+
+unsigned Inflater::bits(int count) {
+	if(!fill(count)) {
+		throw std::runtime_error("compressed data ends early");
+	}
+	
+	const unsigned value = buffer & ((1u << count) - 1);
+	
+	buffer >>= count;
+	held -= count;
+	
+	return value;
+}
+
+unsigned Inflater::decode(const Huffman& huffman) {
+	// Near the end of the input there may be fewer bits left than a table lookup takes
+	if(fill(FAST_BITS)) {
+		const std::uint16_t entry = huffman.fast[buffer & ((1u << FAST_BITS) - 1)];
+		
+		if(entry != 0) {
+			buffer >>= entry & 15;
+			held -= entry & 15;
+			
+			return entry >> 4;
+		}
+	}
+	
+	// Canonical codes of one length are consecutive, so a code of some length is valid if it is below the first code of that length plus their count
+	int code = 0;
+	int first = 0;
+	int index = 0;
+	
+	for(int length = 1; length < 16; length++) {
+		code |= bits(1);
+		
+		const int count = huffman.counts[length];
+		
+		if(code - first < count) {
+			return huffman.symbols[index + code - first];
+		}
+		
+		index += count;
+		first = (first + count) << 1;
+		code <<= 1;
+	}
+	
+	throw std::runtime_error("corrupt compressed data");
+}
+
+void Inflater::start_block() {
+	if(!started) {
+		const unsigned method = bits(8);
+		const unsigned flags = bits(8);
+		
+		// Deflate with a window of at most 32 KiB and no preset dictionary
+		if((method & 15) != 8 || method >> 4 > 7 || (method << 8 | flags) % 31 != 0 || flags & 32) {
+			throw std::runtime_error("unsupported compression");
+		}
+		
+		started = true;
+	} else if(last) {
+		throw std::runtime_error("compressed data ends early");
+	}
+	
+	last = bits(1);
+	
+	const unsigned type = bits(2);
+	
+	if(type == 0) {
+		// Stored blocks start at a byte boundary
+		bits(held % 8);
+		
+		const unsigned length = bits(16);
+		
+		if((length ^ bits(16)) != 0xFFFF) {
+			throw std::runtime_error("corrupt compressed data");
+		}
+		
+		remaining = length;
+		mode = STORED;
+	} else if(type == 1) {
+		unsigned char lengths[288];
+		
+		std::fill(lengths, lengths + 144, 8);
+		std::fill(lengths + 144, lengths + 256, 9);
+		std::fill(lengths + 256, lengths + 280, 7);
+		std::fill(lengths + 280, lengths + 288, 8);
+		literals.build(lengths, 288);
+		
+		std::fill(lengths, lengths + 30, 5);
+		distances.build(lengths, 30);
+		
+		mode = CODES;
+	} else if(type == 2) {
+		const unsigned literal_count = bits(5) + 257;
+		const unsigned distance_count = bits(5) + 1;
+		const unsigned code_count = bits(4) + 4;
+		
+		unsigned char lengths[288 + 32] = {};
+		
+		for(unsigned i = 0; i < code_count; i++) {
+			lengths[LENGTH_ORDER[i]] = bits(3);
+		}
+		
+		Huffman code_lengths;
+		code_lengths.build(lengths, 19);
+		
+		// Both codes are described as one sequence of lengths, where 16 repeats the previous length and 17 and 18 give runs of zeroes
+		std::fill(lengths, lengths + 19, 0);
+		
+		for(unsigned i = 0; i < literal_count + distance_count;) {
+			const unsigned symbol = decode(code_lengths);
+			unsigned repeat = 1;
+			unsigned char length = symbol;
+			
+			if(symbol == 16) {
+				if(i == 0) {
+					throw std::runtime_error("corrupt compressed data");
+				}
+				
+				length = lengths[i - 1];
+				repeat = 3 + bits(2);
+			} else if(symbol == 17) {
+				length = 0;
+				repeat = 3 + bits(3);
+			} else if(symbol == 18) {
+				length = 0;
+				repeat = 11 + bits(7);
+			}
+			
+			if(i + repeat > literal_count + distance_count) {
+				throw std::runtime_error("corrupt compressed data");
+			}
+			
+			std::fill(lengths + i, lengths + i + repeat, length);
+			i += repeat;
+		}
+		
+		literals.build(lengths, literal_count);
+		distances.build(lengths + literal_count, distance_count);
+		
+		mode = CODES;
+	} else {
+		throw std::runtime_error("corrupt compressed data");
+	}
+}
+
+unsigned char Inflater::next() {
+	while(true) {
+		if(copy_length > 0) {
+			copy_length--;
+			
+			return emit(window[(written - copy_distance) & (WINDOW_SIZE - 1)]);
+		}
+		
+		if(mode == HEADER) {
+			start_block();
+		} else if(mode == STORED) {
+			if(remaining > 0) {
+				remaining--;
+				
+				return emit(bits(8));
+			}
+			
+			mode = HEADER;
+		} else {
+			const unsigned symbol = decode(literals);
+			
+			if(symbol < 256) return emit(symbol);
+			
+			if(symbol == 256) {
+				mode = HEADER;
+				continue;
+			}
+			
+			if(symbol > 285) {
+				throw std::runtime_error("corrupt compressed data");
+			}
+			
+			copy_length = LENGTH_BASES[symbol - 257] + bits(LENGTH_EXTRA[symbol - 257]);
+			
+			const unsigned code = decode(distances);
+			
+			if(code > 29) {
+				throw std::runtime_error("corrupt compressed data");
+			}
+			
+			copy_distance = DISTANCE_BASES[code] + bits(DISTANCE_EXTRA[code]);
+			
+			if(copy_distance > written) {
+				throw std::runtime_error("corrupt compressed data");
+			}
+		}
+	}
+}
+
+void Inflater::read(unsigned char* out, std::size_t count) {
+	for(std::size_t i = 0; i < count; i++) {
+		out[i] = next();
+	}
+}
@@ -0,0 +1,73 @@
+#ifndef PIET_INFLATE_H
+#define PIET_INFLATE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// The furthest back references reach
+const std::size_t WINDOW_SIZE = 1 << 15;
+
+// Codes of up to this many bits are decoded with one table lookup, longer ones a bit at a time
+const int FAST_BITS = 9;
+
+// A canonical Huffman code as deflate describes it, by the length of the code of every symbol
+struct Huffman {
+	std::uint16_t fast[1 << FAST_BITS];    // Symbol * 16 + length, indexed by the next FAST_BITS bits, 0 for longer codes
+	std::uint16_t counts[16];              // Number of codes of every length
+	std::uint16_t symbols[288];            // Ordered by code
+	
+	void build(const unsigned char* lengths, int count);
+};
+
+// Decompresses a zlib stream while it is being read, keeping nothing of the output but the 32 KiB that back references can reach. Checksums are not verified. Throws std::runtime_error for corrupt or truncated data
+class Inflater {
+public:
+	// Refill puts up to capacity compressed bytes in buffer and returns how many, 0 once there are no more
+	explicit Inflater(std::function<std::size_t(unsigned char*, std::size_t)> refill);
+	
+	// Fills out with the next count decompressed bytes
+	void read(unsigned char* out, std::size_t count);
+
+private:
+	enum Mode {
+		HEADER,    // At the start of a block
+		STORED,    // Copying remaining bytes
+		CODES      // Decoding symbols
+	};
+	
+	// Loads whole bytes into the bit buffer until it holds at least count bits, returns false if the input ends first
+	bool fill(int count);
+	
+	unsigned bits(int count);
+	unsigned decode(const Huffman& huffman);
+	void start_block();
+	unsigned char next();
+	
+	unsigned char emit(unsigned char byte) {
+		window[written++ & (WINDOW_SIZE - 1)] = byte;
+		return byte;
+	}
+	
+	std::function<std::size_t(unsigned char*, std::size_t)> refill;
+	std::vector<unsigned char> input;
+	std::size_t position;
+	std::size_t available;
+	std::uint64_t buffer;    // Bits not used yet, the next one lowest
+	int held;
+	
+	unsigned char window[WINDOW_SIZE];
+	std::uint64_t written;
+	
+	bool started;
+	bool last;               // The current block is the final one
+	Mode mode;
+	std::uint32_t remaining;    // Of a stored block
+	unsigned copy_length;
+	unsigned copy_distance;
+	Huffman literals;
+	Huffman distances;
+};
+
+#endif //PIET_INFLATE_H
@@ -0,0 +1,559 @@
+#include "jit.h"
+
+#include "handlers.h"
+
+#if PIET_JIT
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+#include <iostream>
+#include <map>
+#include <utility>
+
+// While native code runs rbp points to the JitFrame, rbx to the bottom of the stack, r14 one past its top and r15 to the end of the buffer. Everything else is scratch
+
+static_assert(offsetof(JitFrame, base) == 0 && offsetof(JitFrame, top) == 8 && offsetof(JitFrame, limit) == 16, "JitFrame layout is hardcoded in the emitted code");
+static_assert(offsetof(JitFrame, entry) == 24 && offsetof(JitFrame, exit) == 32, "JitFrame layout is hardcoded in the emitted code");
+
+const std::initializer_list<unsigned char> JMP = {0xE9};
+const std::initializer_list<unsigned char> JA = {0x0F, 0x87};
+const std::initializer_list<unsigned char> JB = {0x0F, 0x82};
+const std::initializer_list<unsigned char> JBE = {0x0F, 0x86};
+const std::initializer_list<unsigned char> JZ = {0x0F, 0x84};
+const std::initializer_list<unsigned char> JNS = {0x0F, 0x89};
+
+const unsigned char EAX = 0;
+const unsigned char ECX = 1;
+const unsigned char EDX = 2;
+
+class Assembler {
+public:
+	std::vector<unsigned char> code;
+	
+	void emit(std::initializer_list<unsigned char> bytes) {
+		code.insert(code.end(), bytes);
+	}
+	
+	void emit32(std::uint32_t value) {
+		for(int i = 0; i < 4; i++) {
+			code.push_back(value >> i * 8);
+		}
+	}
+	
+	void emit64(std::uint64_t value) {
+		for(int i = 0; i < 8; i++) {
+			code.push_back(value >> i * 8);
+		}
+	}
+	
+	// Emits a jump with an empty 32 bit displacement and returns where that displacement is
+	std::size_t jump(std::initializer_list<unsigned char> opcode) {
+		emit(opcode);
+		emit32(0);
+		
+		return code.size() - 4;
+	}
+	
+	// Points the displacement at offset at to the target offset
+	void patch(std::size_t at, std::size_t target) {
+		std::int32_t displacement = target - (at + 4);
+		
+		std::memcpy(&code[at], &displacement, 4);
+	}
+	
+	void bind(std::size_t at) {
+		patch(at, code.size());
+	}
+	
+	std::size_t here() const {
+		return code.size();
+	}
+};
+
+// mov reg, [r14 + offset]
+void load(Assembler& a, unsigned char reg, signed char offset) {
+	a.emit({0x41, 0x8B, static_cast<unsigned char>(0x46 | reg << 3), static_cast<unsigned char>(offset)});
+}
+
+// mov [r14 + offset], reg
+void store(Assembler& a, unsigned char reg, signed char offset) {
+	a.emit({0x41, 0x89, static_cast<unsigned char>(0x46 | reg << 3), static_cast<unsigned char>(offset)});
+}
+
+// sub r14, 4
+void drop(Assembler& a) {
+	a.emit({0x49, 0x83, 0xEE, 0x04});
+}
+
+// add r14, 4
+void advance(Assembler& a) {
+	a.emit({0x49, 0x83, 0xC6, 0x04});
+}
+
+// Jumps over the instruction when the stack holds less than count values, returns the jump to bind behind it
+std::size_t require(Assembler& a, int count) {
+	if(count == 1) {
+		a.emit({0x49, 0x39, 0xDE});          // cmp r14, rbx
+		
+		return a.jump(JBE);
+	}
+	
+	a.emit({0x48, 0x8D, 0x43, 0x08});        // lea rax, [rbx + 8]
+	a.emit({0x49, 0x39, 0xC6});              // cmp r14, rax
+	
+	return a.jump(JB);
+}
+
+// Writes the stack registers back to the frame
+void save(Assembler& a) {
+	a.emit({0x48, 0x89, 0x5D, 0x00});        // mov [rbp], rbx
+	a.emit({0x4C, 0x89, 0x75, 0x08});        // mov [rbp + 8], r14
+	a.emit({0x4C, 0x89, 0x7D, 0x10});        // mov [rbp + 16], r15
+}
+
+void restore(Assembler& a) {
+	a.emit({0x48, 0x8B, 0x5D, 0x00});        // mov rbx, [rbp]
+	a.emit({0x4C, 0x8B, 0x75, 0x08});        // mov r14, [rbp + 8]
+	a.emit({0x4C, 0x8B, 0x7D, 0x10});        // mov r15, [rbp + 16]
+}
+
+// Calls a helper that works on the frame
+void call(Assembler& a, void (* helper)(JitFrame*)) {
+	save(a);
+	a.emit({0x48, 0x89, 0xEF});              // mov rdi, rbp
+	a.emit({0x48, 0xB8});                    // mov rax, helper
+	a.emit64(reinterpret_cast<std::uint64_t>(helper));
+	a.emit({0xFF, 0xD0});                    // call rax
+	restore(a);
+}
+
+void jit_grow(JitFrame* frame) {
+	const std::size_t size = frame->top - frame->base;
+	
+	frame->storage->resize(std::max<std::size_t>(64, frame->storage->size() * 2));
+	
+	frame->base = frame->storage->data();
+	frame->top = frame->base + size;
+	frame->limit = frame->base + frame->storage->size();
+}
+
+// Same as the roll handler, working on the values in the frame
+void jit_roll(JitFrame* frame) {
+	const std::ptrdiff_t size = frame->top - frame->base;
+	
+	if(size < 2) return;
+	
+	const std::int32_t b = frame->top[-1];
+	const std::int32_t a = frame->top[-2];
+	
+	if(a < 0 || a > size - 2) return;
+	
+	frame->top -= 2;
+	
+	if(a > 0) {
+		const std::int32_t shift = (b % a + a) % a;
+		
+		std::rotate(frame->top - a, frame->top - shift, frame->top);
+	}
+}
+
+// Makes room for one more value
+void reserve(Assembler& a) {
+	a.emit({0x4D, 0x39, 0xFE});              // cmp r14, r15
+	
+	const std::size_t room = a.jump(JB);
+	
+	call(a, jit_grow);
+	a.bind(room);
+}
+
+Jit::Jit(const Bytecode& bytecode) {
+	const std::vector<Instruction>& code = bytecode.instructions();
+	
+	Assembler a;
+	
+	// Entry, called as void(JitFrame*) with the frame in rdi
+	
+	a.emit({0x55, 0x53, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57});    // push rbp, rbx, r12, r13, r14, r15
+	a.emit({0x48, 0x83, 0xEC, 0x08});        // sub rsp, 8 to keep calls aligned
+	a.emit({0x48, 0x89, 0xFD});              // mov rbp, rdi
+	restore(a);
+	a.emit({0xFF, 0x65, 0x18});              // jmp [rbp + 24]
+	
+	const std::size_t epilogue = a.here();
+	
+	save(a);
+	a.emit({0x48, 0x83, 0xC4, 0x08});        // add rsp, 8
+	a.emit({0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5B, 0x5D});    // pop r15, r14, r13, r12, rbx, rbp
+	a.emit({0xC3});                          // ret
+	
+	// Leaves native code, so the interpreter can take over at a bytecode address
+	auto leave = [&](std::uint32_t pc) {
+		a.emit({0xC7, 0x45, 0x20});          // mov dword [rbp + 32], pc
+		a.emit32(pc);
+		a.patch(a.jump(JMP), epilogue);
+	};
+	
+	const std::size_t halt = a.here();
+	
+	leave(HALT_EXIT);
+	
+	// Jumps to other bytecode addresses and jump tables are filled in once all code is there
+	std::vector<std::pair<std::size_t, std::uint32_t>> jumps;
+	std::vector<std::pair<std::size_t, unsigned>> tables;
+	
+	// Jumps to the code for the new direction through a table of the 8 Locations of a block, indexed by the dp * 2 + cc in eax
+	auto branch = [&](unsigned block) {
+		a.emit({0x48, 0x8D, 0x0D});          // lea rcx, [rip + table]
+		a.emit32(0);
+		tables.emplace_back(a.here() - 4, block);
+		a.emit({0xFF, 0x24, 0xC1});          // jmp [rcx + rax * 8]
+	};
+	
+	addresses.resize(code.size());
+	
+	for(std::uint32_t pc = 0; pc < code.size(); pc++) {
+		const Instruction& instruction = code[pc];
+		
+		addresses[pc] = a.here();
+		
+		switch(instruction.op) {
+			case PUSH:
+				reserve(a);
+				a.emit({0x41, 0xC7, 0x06});      // mov dword [r14], size
+				a.emit32(instruction.operand);
+				advance(a);
+				break;
+			case POP: {
+				const std::size_t skip = require(a, 1);
+				
+				drop(a);
+				a.bind(skip);
+				break;
+			}
+			case ADD:
+			case SUBTRACT:
+			case MULTIPLY: {
+				const std::size_t skip = require(a, 2);
+				
+				load(a, EAX, -8);
+				
+				if(instruction.op == ADD) {
+					a.emit({0x41, 0x03, 0x46, 0xFC});          // add eax, [r14 - 4]
+				} else if(instruction.op == SUBTRACT) {
+					a.emit({0x41, 0x2B, 0x46, 0xFC});          // sub eax, [r14 - 4]
+				} else {
+					a.emit({0x41, 0x0F, 0xAF, 0x46, 0xFC});    // imul eax, [r14 - 4]
+				}
+				
+				store(a, EAX, -8);
+				drop(a);
+				a.bind(skip);
+				break;
+			}
+			case DIVIDE: {
+				const std::size_t skip = require(a, 2);
+				
+				load(a, ECX, -4);
+				a.emit({0x85, 0xC9});            // test ecx, ecx
+				
+				const std::size_t zero = a.jump(JZ);
+				
+				load(a, EAX, -8);
+				a.emit({0x99, 0xF7, 0xF9});      // cdq, idiv ecx
+				store(a, EAX, -8);
+				drop(a);
+				a.bind(skip);
+				a.bind(zero);
+				break;
+			}
+			case MOD: {
+				const std::size_t skip = require(a, 2);
+				
+				load(a, ECX, -4);
+				a.emit({0x85, 0xC9});            // test ecx, ecx
+				
+				const std::size_t zero = a.jump(JZ);
+				
+				load(a, EAX, -8);
+				a.emit({0x99, 0xF7, 0xF9});      // cdq, idiv ecx
+				a.emit({0x85, 0xD2});            // test edx, edx
+				
+				const std::size_t exact = a.jump(JZ);
+				
+				// A remainder with the sign of the dividend moves over to the sign of the divisor
+				a.emit({0x89, 0xD0});            // mov eax, edx
+				a.emit({0x31, 0xC8});            // xor eax, ecx
+				
+				const std::size_t same = a.jump(JNS);
+				
+				a.emit({0x01, 0xCA});            // add edx, ecx
+				a.bind(exact);
+				a.bind(same);
+				store(a, EDX, -8);
+				drop(a);
+				a.bind(skip);
+				a.bind(zero);
+				break;
+			}
+			case NOT: {
+				const std::size_t skip = require(a, 1);
+				
+				load(a, EAX, -4);
+				a.emit({0x85, 0xC0});            // test eax, eax
+				a.emit({0x0F, 0x94, 0xC0});      // sete al
+				a.emit({0x0F, 0xB6, 0xC0});      // movzx eax, al
+				store(a, EAX, -4);
+				a.bind(skip);
+				break;
+			}
+			case GREATER: {
+				const std::size_t skip = require(a, 2);
+				
+				load(a, EAX, -8);
+				a.emit({0x41, 0x3B, 0x46, 0xFC});    // cmp eax, [r14 - 4]
+				a.emit({0x0F, 0x9F, 0xC0});      // setg al
+				a.emit({0x0F, 0xB6, 0xC0});      // movzx eax, al
+				store(a, EAX, -8);
+				drop(a);
+				a.bind(skip);
+				break;
+			}
+			case DUPLICATE: {
+				const std::size_t skip = require(a, 1);
+				
+				reserve(a);
+				load(a, EAX, -4);
+				a.emit({0x41, 0x89, 0x06});      // mov [r14], eax
+				advance(a);
+				a.bind(skip);
+				break;
+			}
+			case ROLL:
+				call(a, jit_roll);
+				break;
+			case ADD_IMMEDIATE:
+			case SUBTRACT_IMMEDIATE:
+			case MULTIPLY_IMMEDIATE: {
+				// Like a PUSH on an empty stack
+				a.emit({0x49, 0x39, 0xDE});      // cmp r14, rbx
+				
+				const std::size_t values = a.jump(JA);
+				
+				reserve(a);
+				a.emit({0x41, 0xC7, 0x06});      // mov dword [r14], operand
+				a.emit32(instruction.operand);
+				advance(a);
+				
+				const std::size_t done = a.jump(JMP);
+				
+				a.bind(values);
+				
+				if(instruction.op == ADD_IMMEDIATE) {
+					a.emit({0x41, 0x81, 0x46, 0xFC});    // add dword [r14 - 4], operand
+					a.emit32(instruction.operand);
+				} else if(instruction.op == SUBTRACT_IMMEDIATE) {
+					a.emit({0x41, 0x81, 0x6E, 0xFC});    // sub dword [r14 - 4], operand
+					a.emit32(instruction.operand);
+				} else {
+					a.emit({0x41, 0x69, 0x46, 0xFC});    // imul eax, [r14 - 4], operand
+					a.emit32(instruction.operand);
+					store(a, EAX, -4);
+				}
+				
+				a.bind(done);
+				break;
+			}
+			case SQUARE: {
+				const std::size_t skip = require(a, 1);
+				
+				load(a, EAX, -4);
+				a.emit({0x0F, 0xAF, 0xC0});      // imul eax, eax
+				store(a, EAX, -4);
+				a.bind(skip);
+				break;
+			}
+			case ROLL_IMMEDIATE:
+				for(std::uint32_t value : {instruction.operand >> 16, instruction.operand & 0xFFFF}) {
+					reserve(a);
+					a.emit({0x41, 0xC7, 0x06});  // mov dword [r14], value
+					a.emit32(value);
+					advance(a);
+				}
+				
+				call(a, jit_roll);
+				break;
+			case POINTER:
+			case SWITCH: {
+				const Location location = instruction.operand;
+				const std::uint32_t dp = location / 2 % 4;
+				const std::uint32_t cc = location % 2;
+				const std::size_t empty = require(a, 1);
+				
+				load(a, EAX, -4);
+				drop(a);
+				
+				if(instruction.op == POINTER) {
+					a.emit({0x05});              // add eax, dp
+					a.emit32(dp);
+					a.emit({0x83, 0xE0, 0x03});  // and eax, 3
+					a.emit({0x8D, 0x04, 0x45});  // lea eax, [rax * 2 + cc]
+					a.emit32(cc);
+				} else {
+					a.emit({0x05});              // add eax, cc
+					a.emit32(cc);
+					a.emit({0x83, 0xE0, 0x01});  // and eax, 1
+					a.emit({0x05});              // add eax, dp * 2
+					a.emit32(dp * 2);
+				}
+				
+				branch(location / 8);
+				
+				// Nothing to pop, so the direction stays the same
+				a.bind(empty);
+				jumps.emplace_back(a.jump(JMP), bytecode.entry(location));
+				break;
+			}
+			case JUMP:
+			case BRANCH_IMMEDIATE:
+				jumps.emplace_back(a.jump(JMP), instruction.operand);
+				break;
+			case IN_NUMBER:
+			case IN_CHAR:
+			case OUT_NUMBER:
+			case OUT_CHAR:
+				leave(pc);
+				break;
+			default:
+				a.patch(a.jump(JMP), halt);
+		}
+	}
+	
+	for(auto& jump : jumps) {
+		a.patch(jump.first, addresses[jump.second]);
+	}
+	
+	// One table per block, holding native addresses that are only known once the code has its final place
+	
+	while(a.here() % 8 != 0) {
+		a.emit({0xCC});
+	}
+	
+	std::map<unsigned, std::size_t> offsets;
+	
+	for(auto& table : tables) {
+		if(offsets.find(table.second) == offsets.end()) {
+			offsets[table.second] = a.here();
+			
+			for(int i = 0; i < 8; i++) {
+				a.emit64(0);
+			}
+		}
+		
+		a.patch(table.first, offsets[table.second]);
+	}
+	
+	size = a.here();
+	
+	void* mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	
+	if(mapped == MAP_FAILED) return;
+	
+	memory = static_cast<unsigned char*>(mapped);
+	std::memcpy(memory, a.code.data(), size);
+	
+	for(auto& offset : offsets) {
+		for(unsigned exit = 0; exit < 8; exit++) {
+			const std::uint32_t pc = bytecode.entry(offset.first * 8 + exit);
+			const std::uint64_t target = reinterpret_cast<std::uint64_t>(memory + (pc == UNCOMPILED ? halt : addresses[pc]));
+			
+			std::memcpy(memory + offset.second + exit * 8, &target, 8);
+		}
+	}
+	
+	if(mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+		munmap(memory, size);
+		memory = nullptr;
+	}
+}
+
+Jit::~Jit() {
+	if(memory) {
+		munmap(memory, size);
+	}
+}
+
+// Input and output never leave the interpreter. These mirror their handlers, but work on the values in the frame
+void interpret(const Instruction& instruction, JitFrame& frame, std::istream& in, std::ostream& out) {
+	switch(instruction.op) {
+		case IN_NUMBER: {
+			int a = 0;
+			
+			in >> a;
+			
+			if(frame.top == frame.limit) jit_grow(&frame);
+			
+			*frame.top++ = a;
+			break;
+		}
+		case IN_CHAR: {
+			char a = 0;
+			
+			in >> a;
+			
+			if(frame.top == frame.limit) jit_grow(&frame);
+			
+			*frame.top++ = a;
+			break;
+		}
+		case OUT_NUMBER:
+			if(frame.top == frame.base) return;
+			
+			out << *--frame.top;
+			break;
+		case OUT_CHAR:
+			if(frame.top == frame.base) return;
+			
+			out << static_cast<char>(*--frame.top);
+			break;
+	}
+}
+
+void run_jit(const Bytecode& bytecode, VM<std::int32_t>& vm) {
+	const Jit jit(bytecode);
+	
+	if(!jit.compiled()) {
+		run(bytecode, vm);
+		return;
+	}
+	
+	std::vector<std::int32_t> storage(std::max<std::size_t>(64, vm.stack.size() * 2));
+	
+	JitFrame frame = {storage.data(), storage.data() + vm.stack.size(), storage.data() + storage.size(), jit.address(bytecode.start()), 0, &storage};
+	
+	std::copy(vm.stack.data(), vm.stack.data() + vm.stack.size(), frame.base);
+	
+	while(true) {
+		jit.enter(frame);
+		
+		if(frame.exit == HALT_EXIT) break;
+		
+		interpret(bytecode.instructions()[frame.exit], frame, *vm.in, *vm.out);
+		
+		frame.entry = jit.address(frame.exit + 1);
+	}
+	
+	vm.stack.assign(frame.base, frame.top);
+}
+
+#else
+
+void run_jit(const Bytecode& bytecode, VM<std::int32_t>& vm) {
+	run(bytecode, vm);
+}
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef PIET_JIT_H
+#define PIET_JIT_H
+
+#include "bytecode.h"
+#include "vm.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__))
+#define PIET_JIT 1
+#else
+#define PIET_JIT 0
+#endif
+
+// What native code works on. The stack lives in one contiguous buffer while native code runs
+struct JitFrame {
+	std::int32_t* base;
+	std::int32_t* top;      // One past the topmost value
+	std::int32_t* limit;    // End of the buffer
+	const void* entry;      // Where to start executing
+	std::uint32_t exit;     // Address of the instruction the interpreter has to execute, or HALT_EXIT
+	std::vector<std::int32_t>* storage;
+};
+
+const std::uint32_t HALT_EXIT = UINT32_MAX;
+
+// Bytecode translated to x86-64. Every instruction is compiled except input and output, which leave native code so the interpreter can execute them
+class Jit {
+public:
+	explicit Jit(const Bytecode& bytecode);
+	~Jit();
+	
+	Jit(const Jit&) = delete;
+	Jit& operator=(const Jit&) = delete;
+	
+	// False if no executable memory could be had
+	bool compiled() const {
+		return memory;
+	}
+	
+	// Native address of the instruction at a bytecode address
+	const void* address(std::uint32_t pc) const {
+		return memory + addresses[pc];
+	}
+	
+	// Runs native code from frame.entry until it exits
+	void enter(JitFrame& frame) const {
+		reinterpret_cast<void (*)(JitFrame*)>(memory)(&frame);
+	}
+
+private:
+	unsigned char* memory = nullptr;
+	std::size_t size = 0;
+	std::vector<std::uint32_t> addresses;
+};
+
+// Runs until the program terminates, in native code where possible. Native code only knows 32 bit cells. Without a JIT for this platform it just interprets
+void run_jit(const Bytecode& bytecode, VM<std::int32_t>& vm);
+
+#endif //PIET_JIT_H
@@ -0,0 +1,88 @@
+#include "lzw.h"
+
+#include <stdexcept>
+#include <utility>
+
+Lzw::Lzw(int minimum_size, std::function<std::size_t(unsigned char*, std::size_t)> refill)
+		: refill(std::move(refill)), input(256), position(0), available(0), buffer(0), held(0), minimum_size(minimum_size), size(minimum_size + 1), clear(1u << minimum_size), next(clear + 2), previous(-1), waiting(0) {
+	if(minimum_size < 2 || minimum_size > 11) {
+		throw std::runtime_error("corrupt compressed data");
+	}
+	
+	for(unsigned code = 0; code < clear; code++) {
+		suffixes[code] = code;
+		firsts[code] = code;
+	}
+}
+
+unsigned Lzw::code() {
+	while(held < size) {
+		if(position == available) {
+			position = 0;
+			available = refill(input.data(), input.size());
+			
+			if(available == 0) {
+				throw std::runtime_error("compressed data ends early");
+			}
+		}
+		
+		buffer |= static_cast<std::uint32_t>(input[position++]) << held;
+		held += 8;
+	}
+	
+	const unsigned value = buffer & ((1u << size) - 1);
+	
+	buffer >>= size;
+	held -= size;
+	
+	return value;
+}
+
+void Lzw::read(unsigned char* out, std::size_t count) {
+	for(std::size_t i = 0; i < count; i++) {
+		while(waiting == 0) {
+			const unsigned current = code();
+			
+			if(current == clear) {
+				size = minimum_size + 1;
+				next = clear + 2;
+				previous = -1;
+				continue;
+			}
+			
+			if(current == clear + 1 || (previous < 0 && current > clear) || current > next) {
+				throw std::runtime_error(current == clear + 1 ? "compressed data ends early" : "corrupt compressed data");
+			}
+			
+			// The one code that is not in the table yet is the previous entry followed by its own first byte
+			unsigned entry = current;
+			
+			if(current == next) {
+				pending[waiting++] = firsts[previous];
+				entry = previous;
+			}
+			
+			for(; entry >= clear; entry = prefixes[entry]) {
+				pending[waiting++] = suffixes[entry];
+			}
+			
+			pending[waiting++] = entry;
+			
+			// Once the table is full codes stay 12 bits wide and nothing is added until the next clear
+			if(previous >= 0 && next < 4096) {
+				prefixes[next] = previous;
+				suffixes[next] = entry;
+				firsts[next] = firsts[previous];
+				next++;
+				
+				if(next == 1u << size && size < 12) {
+					size++;
+				}
+			}
+			
+			previous = current;
+		}
+		
+		out[i] = pending[--waiting];
+	}
+}
@@ -0,0 +1,44 @@
+#ifndef PIET_LZW_H
+#define PIET_LZW_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Decompresses the variable length LZW codes of a gif while they are being read. Throws std::runtime_error for corrupt or truncated data
+class Lzw {
+public:
+	// Codes start one bit wider than the given size, refill works like the one of Inflater
+	Lzw(int minimum_size, std::function<std::size_t(unsigned char*, std::size_t)> refill);
+	
+	// Fills out with the next count decompressed bytes
+	void read(unsigned char* out, std::size_t count);
+
+private:
+	unsigned code();
+	
+	std::function<std::size_t(unsigned char*, std::size_t)> refill;
+	std::vector<unsigned char> input;
+	std::size_t position;
+	std::size_t available;
+	std::uint32_t buffer;    // Bits not used yet, the next one lowest
+	int held;
+	
+	int minimum_size;
+	int size;                // Of the next code
+	unsigned clear;          // Code that empties the table
+	unsigned next;           // Code the next entry gets
+	int previous;            // Code before this one, -1 right after a clear
+	
+	// Every entry is an earlier entry with one byte appended
+	std::uint16_t prefixes[4096];
+	unsigned char suffixes[4096];
+	unsigned char firsts[4096];
+	
+	// Bytes of the current entry, last one first
+	unsigned char pending[4096];
+	int waiting;
+};
+
+#endif //PIET_LZW_H
@@ -1,511 +1,300 @@
-#include <iostream>
+#include "batch.h"
+#include "big.h"
+#include "bytecode.h"
+#include "cache.h"
+#include "cell.h"
+#include "emit_c.h"
+#include "emit_header.h"
+#include "expanded.h"
+#include "image.h"
+#include "fusion.h"
+#include "jit.h"
+#include "program.h"
+#include "propagate.h"
+#include "vm.h"
+
 #include <algorithm>
-#include <stack>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
 #include <vector>
-#include <cmath>
-
-// LIGHT NONE is white and DARK NONE is black, NORMAL NONE is undefined
-enum Hue {
-	RED = 0, YELLOW = 1, GREEN = 2, CYAN = 3, BLUE = 4, MAGENTA = 5, NONE = 6
-};
-
-enum Lightness {
-	LIGHT = 0, NORMAL = 1, DARK = 2
-};
-
-struct Color {
-	Lightness lightness;
-	Hue hue;
-};
-
-struct Position {
-	int x;
-	int y;
-};
-
-struct Block {
-	Color color;
-	std::vector<Position> positions;
-	struct Block* neighbors[8];
-};
-
-struct State {
-	Block current;
-	std::stack<int> stack;
-	short dp = 0;    // 0 is right, 1 is down, 2 is left, 3 is up
-	short cc = 0;    // 0 is left, 1 is right
-	short turned = 0;
-	bool swapped = false;
-};
-
-bool operator==(const Position& p1, const Position& p2) {
-	return p1.x == p2.x && p1.y == p2.y;
-}
-
-bool compare_x(const Position& p1, const Position& p2) {
-	return p1.x < p2.x;
-}
-
-bool compare_y(const Position& p1, const Position& p2) {
-	return p1.y < p2.y;
-}
 
-typedef void (* command)(State&);
-
-void skip(State& state) {
-	// ¯\_(ツ)_/¯
-}
-
-void push(State& state) {
-	int a = state.current.positions.size();
-	
-	state.stack.push(a);
+void usage() {
+	std::cerr << "usage: piet [--engine=graph|expanded|bytecode|jit] [--dispatch=call|switch|threaded] [--cell=int32|int64|int128|big] [--overflow=wrap|trap|promote] [--codel-size=N|auto] [--verify-codels] [--threads=N] [--cache=DIR] [--memory-report] [--no-fuse] [--no-propagate] [--profile] [--emit-c] [--emit-header] image" << std::endl;
+	std::cerr << "       piet [--cell=int32|int64] [--codel-size=N|auto] [--verify-codels] [--threads=N] [--cache=DIR] --batch=MANIFEST" << std::endl;
+	std::cerr << "--threads=N also labels blocks with N threads, which holds 5 bytes per codel of the image in memory. Without it images stream through one thread in memory proportional to their width" << std::endl;
+	std::cerr << "--dispatch=MODE picks how the bytecode interpreter dispatches, the jit engine runs native code for int32 cells and ignores it" << std::endl;
 }
 
-void pop(State& state) {
-	if(state.stack.empty()) return;
-	
-	state.stack.pop();
+// Native code only exists for 32 bit cells, anything wider is interpreted. Native code has no dispatch, so --dispatch only applies to the interpreters
+void run_native(const Bytecode& bytecode, VM<std::int32_t>& vm, Dispatch) {
+	run_jit(bytecode, vm);
 }
 
-void add(State& state) {
-	if(state.stack.size() < 2) return;
-	
-	int b = state.stack.top();
-	state.stack.pop();
-	
-	int a = state.stack.top();
-	state.stack.pop();
-	
-	state.stack.push(a + b);
+template<typename Cell>
+void run_native(const Bytecode& bytecode, VM<Cell>& vm, Dispatch dispatch) {
+	run(bytecode, vm, dispatch);
 }
 
-void subtract(State& state) {
-	if(state.stack.size() < 2) return;
-	
-	int b = state.stack.top();
-	state.stack.pop();
-	
-	int a = state.stack.top();
-	state.stack.pop();
-	
-	state.stack.push(a - b);
-}
-
-void multiply(State& state) {
-	if(state.stack.size() < 2) return;
-	
-	int b = state.stack.top();
-	state.stack.pop();
-	
-	int a = state.stack.top();
-	state.stack.pop();
+// Runs the program with one type of cell, returns false for an unknown engine. With a profile it always interprets the bytecode, one instruction at a time
+template<typename Cell>
+bool execute(const Program& program, const Bytecode& bytecode, const char* engine, Dispatch dispatch, Profile* profile) {
+	VM<Cell> vm;
+	vm.block = program.start();
+	
+	try {
+		if(profile) {
+			run_profiled(bytecode, vm, *profile);
+		} else if(std::strcmp(engine, "graph") == 0) {
+			run(program, vm);
+		} else if(std::strcmp(engine, "expanded") == 0) {
+			run(Expanded(program), vm);
+		} else if(std::strcmp(engine, "bytecode") == 0) {
+			run(bytecode, vm, dispatch);
+		} else if(std::strcmp(engine, "jit") == 0) {
+			run_native(bytecode, vm, dispatch);
+		} else {
+			return false;
+		}
+	} catch(const Overflow& overflow) {
+		std::cout.flush();
+		std::cerr << "piet: " << overflow.what() << " in block " << vm.block << " at step " << vm.steps << std::endl;
+		throw;
+	}
 	
-	state.stack.push(a * b);
+	return true;
 }
 
-void divide(State& state) {
-	if(state.stack.size() < 2) return;
+// Loads an image, or maps it from the cache when there is one. A codel size of 0 is detected with scanning threads, labeling threads find the blocks. Throws std::runtime_error for images it cannot read, or whose codels are not one color each when verifying
+Program load_program(const char* filename, int codel_size, bool verifying, const char* cache, unsigned scanning, unsigned labeling) {
+	// Cached by the codel size that was asked for, so a cached image skips detection too. Verifying always reads the image
+	const std::string cached = cache ? cache_file(cache, filename, codel_size) : "";
+	Program program({}, {}, {}, {});
 	
-	int b = state.stack.top();
+	if(cache && !verifying && load_cached(cached, program)) return program;
 	
-	if(b != 0) {
-		state.stack.pop();
+	// Every codel of a detected size is one color, a given size only has to be checked when asked to
+	if(codel_size == 0 || verifying) {
+		const int detected = detect_codel_size(filename, scanning);
 		
-		int a = state.stack.top();
-		state.stack.pop();
+		if(codel_size != 0 && detected % codel_size != 0) {
+			throw std::runtime_error(std::string(filename) + " does not divide into codels of size " + std::to_string(codel_size) + " that are one color each, the largest size that does is " + std::to_string(detected));
+		}
 		
-		state.stack.push(a / b);
+		codel_size = codel_size != 0 ? codel_size : detected;
 	}
-}
-
-void mod(State& state) {
-	if(state.stack.size() < 2) return;
-	
-	int b = state.stack.top();
-	state.stack.pop();
-	
-	int a = state.stack.top();
-	state.stack.pop();
-	
-	state.stack.push(((a % b) + b) % b);
-}
-
-void nott(State& state) {
-	if(state.stack.empty()) return;
-	
-	int a = state.stack.top();
-	state.stack.pop();
-	
-	state.stack.push(!a);
-}
-
-void greater(State& state) {
-	if(state.stack.size() < 2) return;
 	
-	int b = state.stack.top();
-	state.stack.pop();
+	program = load_image(filename, codel_size, labeling);
 	
-	int a = state.stack.top();
-	state.stack.pop();
-	
-	state.stack.push(a > b);
-}
-
-void pointer(State& state) {
-	if(state.stack.empty()) return;
-	
-	int a = state.stack.top();
-	state.stack.pop();
-	
-	state.dp = (((state.dp + a) % 4) + 4) % 4;
-}
-
-void switchh(State& state) {
-	if(state.stack.empty()) return;
-	
-	int a = state.stack.top();
-	state.stack.pop();
-	
-	state.cc = (((state.cc + a) % 2) + 2) % 2;
-}
-
-void duplicate(State& state) {
-	if(state.stack.empty()) return;
-	
-	int a = state.stack.top();
-	state.stack.pop();
+	if(cache) {
+		save_cached(program, cached);
+	}
 	
-	state.stack.push(a);
-	state.stack.push(a);
+	return program;
 }
 
-void roll(State& state) {
-	if(state.stack.size() < 2) return;
-	
-	int b = state.stack.top();
-	state.stack.pop();
-	
-	int a = state.stack.top();
-	
-	if(a > state.stack.size()) {
-		state.stack.push(b);
-		return;
+// Runs every job of a manifest and lists the output file, status and steps of each, in the order of the manifest. Exits with the worst status of any job
+int batch(const char* manifest, const char* cell, int codel_size, bool verifying, const char* cache, unsigned threads) {
+	std::vector<Job> jobs;
+	std::vector<Outcome> outcomes;
+	
+	// Images are loaded side by side, so each one gets a single thread
+	const auto load = [&](const char* image) {
+		return load_program(image, codel_size, verifying, cache, 1, 1);
+	};
+	
+	try {
+		jobs = read_manifest(manifest);
+	} catch(const std::runtime_error& error) {
+		std::cerr << "piet: " << error.what() << std::endl;
+		return 1;
 	}
 	
-	state.stack.pop();
+	if(std::strcmp(cell, "int32") == 0) {
+		outcomes = run_batch<Checked<std::int32_t>>(jobs, load, threads);
+	} else if(std::strcmp(cell, "int64") == 0) {
+		outcomes = run_batch<Checked<std::int64_t>>(jobs, load, threads);
+	} else {
+		usage();
+		return 1;
+	}
 	
-	std::stack<int> temp;
+	int status = 0;
 	
-	for(int i = 0; i < b; i++) {
-		int n = state.stack.top();
-		state.stack.pop();
+	for(std::size_t i = 0; i < jobs.size(); i++) {
+		std::cout << jobs[i].output << '\t' << outcomes[i].status << '\t' << outcomes[i].steps << '\n';
 		
-		for(int ii = 0; ii < a - 1; ii++) {
-			temp.push(state.stack.top());
-			state.stack.pop();
+		if(outcomes[i].status != 0) {
+			std::cerr << "piet: " << jobs[i].output << ": " << outcomes[i].error << std::endl;
 		}
 		
-		state.stack.push(n);
-		
-		while(!temp.empty()) {
-			state.stack.push(temp.top());
-			temp.pop();
-		}
+		status = std::max(status, outcomes[i].status);
 	}
-}
-
-void in_number(State& state) {
-	int a;
-	
-	std::cin >> a;
 	
-	state.stack.push(a);
+	return status;
 }
 
-void in_char(State& state) {
-	char a;
-	
-	std::cin >> a;
-	
-	state.stack.push(a);
-}
-
-void out_number(State& state) {
-	if(state.stack.empty()) return;
+int main(int argc, char** argv) {
+	int codel_size = 0;    // Detected from the image
+	int threads = 0;    // Until --threads gives a number
+	const char* engine = "jit";
+	const char* cell = "int32";
+	const char* overflow = "wrap";
+	Dispatch dispatch = THREADED_DISPATCH;
+	const char* filename = nullptr;
+	const char* cache = nullptr;
+	const char* manifest = nullptr;
+	bool translate = false;
+	bool embedding = false;
+	bool fusing = true;
+	bool propagating = true;
+	bool profiling = false;
+	bool reporting = false;
+	bool verifying = false;
+	
+	for(int i = 1; i < argc; i++) {
+		if(std::strncmp(argv[i], "--engine=", 9) == 0) {
+			engine = argv[i] + 9;
+		} else if(std::strncmp(argv[i], "--cell=", 7) == 0) {
+			cell = argv[i] + 7;
+		} else if(std::strncmp(argv[i], "--overflow=", 11) == 0) {
+			overflow = argv[i] + 11;
+		} else if(std::strcmp(argv[i], "--dispatch=call") == 0) {
+			dispatch = CALL_DISPATCH;
+		} else if(std::strcmp(argv[i], "--dispatch=switch") == 0) {
+			dispatch = SWITCH_DISPATCH;
+		} else if(std::strcmp(argv[i], "--dispatch=threaded") == 0) {
+			dispatch = THREADED_DISPATCH;
+		} else if(std::strcmp(argv[i], "--no-fuse") == 0) {
+			fusing = false;
+		} else if(std::strcmp(argv[i], "--no-propagate") == 0) {
+			propagating = false;
+		} else if(std::strcmp(argv[i], "--profile") == 0) {
+			profiling = true;
+		} else if(std::strcmp(argv[i], "--memory-report") == 0) {
+			reporting = true;
+		} else if(std::strcmp(argv[i], "--emit-c") == 0) {
+			translate = true;
+		} else if(std::strcmp(argv[i], "--emit-header") == 0) {
+			embedding = true;
+		} else if(std::strcmp(argv[i], "--verify-codels") == 0) {
+			verifying = true;
+		} else if(std::strcmp(argv[i], "--codel-size=auto") == 0) {
+			codel_size = 0;
+		} else if(std::strncmp(argv[i], "--codel-size=", 13) == 0) {
+			codel_size = std::atoi(argv[i] + 13) > 0 ? std::atoi(argv[i] + 13) : -1;
+		} else if(std::strncmp(argv[i], "--threads=", 10) == 0) {
+			threads = std::atoi(argv[i] + 10) > 0 ? std::atoi(argv[i] + 10) : -1;
+		} else if(std::strncmp(argv[i], "--cache=", 8) == 0 && argv[i][8] != '\0') {
+			cache = argv[i] + 8;
+		} else if(std::strncmp(argv[i], "--batch=", 8) == 0 && argv[i][8] != '\0') {
+			manifest = argv[i] + 8;
+		} else if(argv[i][0] != '-' && !filename) {
+			filename = argv[i];
+		} else {
+			usage();
+			return 1;
+		}
+	}
 	
-	int a = state.stack.top();
-	state.stack.pop();
+	if(!filename == !manifest || codel_size < 0 || threads < 0) {
+		usage();
+		return 1;
+	}
 	
-	std::cout << a;
-}
-
-void out_char(State& state) {
-	if(state.stack.empty()) return;
+	// Checked cells only come in 32 and 64 bits
+	if(std::strcmp(cell, "int128") == 0 && std::strcmp(overflow, "trap") == 0) {
+		std::cerr << "piet: --overflow=trap is not supported with --cell=int128, use --cell=int64 to trap or --overflow=promote to never overflow" << std::endl;
+		return 1;
+	}
 	
-	int a = state.stack.top();
-	state.stack.pop();
+	// Detection only keeps a row per thread, so it uses every core. More than one labeling thread holds the whole image in memory, so that takes asking for
+	const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+	const unsigned scanning = threads > 0 ? threads : cores;
+	const unsigned labeling = threads > 0 ? threads : 1;
 	
-	std::cout << static_cast<char>(a);
-}
-
-const command commands[3][6] = {{skip, add,      divide, greater, duplicate, in_char},
-								{push, subtract, mod,    pointer, roll,      out_number},
-								{pop,  multiply, nott,   switchh, in_number, out_char}};
-
-const command& get_command(const Block& from, const Block& to) {
-	if((from.color.hue == NONE and from.color.lightness == LIGHT) or (to.color.hue == NONE and to.color.lightness == LIGHT)) {
-		// Either going to or coming from a white Color Block
-		return commands[0][0];
+	if(manifest) {
+		return batch(manifest, cell, codel_size, verifying, cache, scanning);
 	}
 	
-	short hue_change = (to.color.hue - from.color.hue + 6) % 6;
-	short lightness_change = (to.color.lightness - from.color.lightness + 3) % 3;
+	Program program({}, {}, {}, {});
 	
-	return commands[lightness_change][hue_change];
-}
-
-void next_state(State& state) {
-	Block next = *state.current.neighbors[state.dp * 2 + state.cc];
-	
-	if(next.color.hue == NONE && next.color.lightness == DARK) {
-		// Bumped into black block or fell off the edge
-		if(state.swapped) {
-			state.dp = (state.dp + 1) % 4;
-			state.turned++;
-		} else {
-			state.cc = (state.cc + 1) % 2;
-			state.swapped = !state.swapped;
-		}
-	} else {
-		// Perform operation associated with the color transition
-		get_command(state.current, next)(state);
-		state.current = next;
-		
-		state.turned = 0;
-		state.swapped = false;
+	try {
+		program = load_program(filename, codel_size, verifying, cache, scanning, labeling);
+	} catch(const std::runtime_error& error) {
+		std::cerr << "piet: " << error.what() << std::endl;
+		return 1;
 	}
-}
-
-void expand(const std::vector<std::vector<Color>>& colors, std::vector<std::vector<bool>>& done, int x, int y, std::vector<Position>& positions) {
-	const Color color = colors[x][y];
 	
-	positions.push_back({x, y});
+	if(embedding) {
+		emit_header(program, std::cout, filename);
+		return 0;
+	}
 	
-	done[x][y] = true;
+	FusionReport report;
+	unsigned resolved = 0;
+	Bytecode bytecode = compile(program);
 	
-	// White pixels should be color blocks on their own, even when their neighbors are also white, because that allows us to "slide across" them without adding code
-	if(color.lightness != LIGHT || color.hue != NONE) {
-		if(x > 0 && !done[x - 1][y] && colors[x - 1][y].lightness == color.lightness && colors[x - 1][y].hue == color.hue) {
-			expand(colors, done, x - 1, y, positions);
-		}
-		
-		if(y > 0 && !done[x][y - 1] and colors[x][y - 1].lightness == color.lightness && colors[x][y - 1].hue == color.hue) {
-			expand(colors, done, x, y - 1, positions);
-		}
-		
-		if(x < colors.size() - 1 && !done[x + 1][y] and colors[x + 1][y].lightness == color.lightness && colors[x + 1][y].hue == color.hue) {
-			expand(colors, done, x + 1, y, positions);
-		}
-		
-		if(y < colors[0].size() - 1 && !done[x][y + 1] and colors[x][y + 1].lightness == color.lightness && colors[x][y + 1].hue == color.hue) {
-			expand(colors, done, x, y + 1, positions);
-		}
-	}
-}
-
-Block& find_block(const Position& pos, std::vector<Block>& blocks) {
-	for(int i = 0; i < blocks.size() - 1; i++) {
-		if(std::find(blocks[i].positions.begin(), blocks[i].positions.end(), pos) != blocks[i].positions.end()) {
-			return blocks[i];
-		}
+	if(fusing) {
+		bytecode = fuse(bytecode, &report);
 	}
 	
-	return blocks.back();
-}
-
-std::vector<Block> load_image(const char* image, const int codel_size) {
-	
-	// Read image
-	
-	unsigned char header[54];
-	
-	FILE* file = fopen(image, "rb");
-	
-	fread(header, sizeof(unsigned char), 54, file);
-	
-	int width = (*(int*) &header[18]);
-	int height = (*(int*) &header[22]);
-	int size = 3 * width * height;
-	
-	auto* data = new unsigned char[size];
-	fread(data, sizeof(unsigned char), size, file);
-	
-	fclose(file);
-	
-	width /= codel_size;
-	height /= codel_size;
-	
-	// Transform image to colors
-	
-	std::vector<std::vector<Color>> colors(width, std::vector<Color>(height));
-	
-	for(int y = 0; y < height; y++) {
-		for(int x = 0; x < width; x++) {
-			int loc = ((height * codel_size - y * codel_size - codel_size) * width * codel_size + x * codel_size);
-			int blue = data[3 * loc];
-			int green = data[3 * loc + 1];
-			int red = data[3 * loc + 2];
-			
-			if(red < 32) {
-				if(green < 32) {
-					if(blue < 32) {
-						colors[x][y] = {DARK, NONE};
-					} else if(blue > 224) {
-						colors[x][y] = {NORMAL, BLUE};
-					} else {
-						colors[x][y] = {DARK, BLUE};
-					}
-				} else if(green > 224) {
-					if(blue < 32) {
-						colors[x][y] = {NORMAL, GREEN};
-					} else {
-						colors[x][y] = {NORMAL, CYAN};
-					}
-				} else {
-					if(blue < 32) {
-						colors[x][y] = {DARK, GREEN};
-					} else {
-						colors[x][y] = {DARK, CYAN};
-					}
-				}
-			} else if (red > 224) {
-				if(green < 32) {
-					if(blue < 32) {
-						colors[x][y] = {NORMAL, RED};
-					} else {
-						colors[x][y] = {NORMAL, MAGENTA};
-					}
-				} else if(green > 224) {
-					if(blue < 32) {
-						colors[x][y] = {NORMAL, YELLOW};
-					} else if(blue > 224) {
-						colors[x][y] = {LIGHT, NONE};
-					} else {
-						colors[x][y] = {LIGHT, YELLOW};
-					}
-				} else {
-					if(blue <= 224) {
-						colors[x][y] = {LIGHT, RED};
-					} else {
-						colors[x][y] = {LIGHT, MAGENTA};
-					}
-				}
-			} else {
-				if(green < 32) {
-					if(blue < 32) {
-						colors[x][y] = {DARK, RED};
-					} else {
-						colors[x][y] = {DARK, MAGENTA};
-					}
-				} else if(green > 224) {
-					if(blue <= 224) {
-						colors[x][y] = {LIGHT, GREEN};
-					} else {
-						colors[x][y] = {LIGHT, CYAN};
-					}
-				} else {
-					if(blue < 32) {
-						colors[x][y] = {DARK, YELLOW};
-					} else {
-						colors[x][y] = {LIGHT, BLUE};
-					}
-				}
-			}
-		}
+	if(propagating) {
+		bytecode = propagate(bytecode, &resolved);
 	}
 	
-	delete[] data;
+	if(translate) {
+		emit_c(bytecode, std::cout, filename);
+		return 0;
+	}
 	
-	// Find Color blocks
+	if(reporting) {
+		Expanded(program).report(std::cerr, program);
+	}
 	
-	std::vector<std::vector<bool>> done(width, std::vector<bool>(height, false));
+	Profile profile;
+	Profile* profiled = profiling ? &profile : nullptr;
+	bool known = false;
 	
-	std::vector<Block> blocks;
+	// Promoting means a value that overflows moves to a wider representation, which is exactly what Big does past 64 bits
+	const bool trap = std::strcmp(overflow, "trap") == 0;
 	
-	for(int y = 0; y < height; y++) {
-		for(int x = 0; x < width; x++) {
-			if(!done[x][y]) {
-				std::vector<Position> positions;
-				
-				expand(colors, done, x, y, positions);
-				
-				Block block = {colors[x][y], positions};
-				
-				blocks.push_back(block);
-			}
-		}
+	if(std::strcmp(overflow, "promote") == 0) {
+		cell = "big";
+	} else if(!trap && std::strcmp(overflow, "wrap") != 0) {
+		cell = "";
 	}
 	
-	blocks.push_back({{DARK, NONE}});    // This black block will represent all edges of the program
-	
-	// Assign neighbors to all blocks
-	
-	for(int i = 0; i < blocks.size() - 1; i++) {
-		
-		std::vector<Position> right;
-		std::vector<Position> down;
-		std::vector<Position> left;
-		std::vector<Position> up;
-		
-		for(auto & position : blocks[i].positions) {
-			if(right.empty() || right[0].x <= position.x) {
-				if(!right.empty() && right[0].x != position.x) right.clear();
-				right.push_back(position);
-			}
-			
-			if(down.empty() || down[0].y <= position.y) {
-				if(!down.empty() && down[0].y != position.y) down.clear();
-				down.push_back(position);
-			}
-			
-			if(left.empty() || left[0].x >= position.x) {
-				if(!left.empty() && left[0].x != position.x) left.clear();
-				left.push_back(position);
-			}
-			
-			if(up.empty() || up[0].y >= position.y) {
-				if(!up.empty() && up[0].y != position.y) up.clear();
-				up.push_back(position);
-			}
+	try {
+		if(std::strcmp(cell, "int32") == 0) {
+			known = trap ? execute<Checked<std::int32_t>>(program, bytecode, engine, dispatch, profiled) : execute<std::int32_t>(program, bytecode, engine, dispatch, profiled);
+		} else if(std::strcmp(cell, "int64") == 0) {
+			known = trap ? execute<Checked<std::int64_t>>(program, bytecode, engine, dispatch, profiled) : execute<std::int64_t>(program, bytecode, engine, dispatch, profiled);
+#if defined(__SIZEOF_INT128__)
+		} else if(std::strcmp(cell, "int128") == 0) {
+			known = execute<int128>(program, bytecode, engine, dispatch, profiled);
+#endif
+		} else if(std::strcmp(cell, "big") == 0) {
+			known = execute<Big>(program, bytecode, engine, dispatch, profiled);
 		}
-		
-		blocks[i].neighbors[0] = &find_block({right[0].x + 1, (*std::min_element(right.begin(), right.end(), compare_y)).y}, blocks);
-		blocks[i].neighbors[1] = &find_block({right[0].x + 1, (*std::max_element(right.begin(), right.end(), compare_y)).y}, blocks);
-		blocks[i].neighbors[2] = &find_block({(*std::max_element(down.begin(), down.end(), compare_x)).x, down[0].y + 1}, blocks);
-		blocks[i].neighbors[3] = &find_block({(*std::min_element(down.begin(), down.end(), compare_x)).x, down[0].y + 1}, blocks);
-		blocks[i].neighbors[4] = &find_block({left[0].x - 1, (*std::max_element(left.begin(), left.end(), compare_y)).y}, blocks);
-		blocks[i].neighbors[5] = &find_block({left[0].x - 1, (*std::min_element(left.begin(), left.end(), compare_y)).y}, blocks);
-		blocks[i].neighbors[6] = &find_block({(*std::min_element(up.begin(), up.end(), compare_x)).x, up[0].y - 1}, blocks);
-		blocks[i].neighbors[7] = &find_block({(*std::max_element(up.begin(), up.end(), compare_x)).x, up[0].y - 1}, blocks);
+	} catch(const Overflow&) {
+		return 2;
 	}
 	
-	return blocks;
-}
-
-int main() {
-	const int codel_size = 20;
-	const char* filename = "/home/rick/CLionProjects/piet/palindrome.bmp";
-	
-	std::vector<Block> blocks = load_image(filename, codel_size);
-	
-	State state = {blocks.front()};
+	if(!known) {
+		usage();
+		return 1;
+	}
 	
-	if(state.current.color.hue != NONE || state.current.color.lightness != DARK) {
-		while(state.turned < 4) {
-			next_state(state);
-		}
+	if(profiling) {
+		std::cout.flush();
+		profile.write(std::cerr, report);
+		std::cerr << "branches resolved by propagation: " << resolved << std::endl;
 	}
 	
 	return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,65 @@
+#include "mapping.h"
+
+#include <stdexcept>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define PIET_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define PIET_MMAP 0
+#include <fstream>
+#include <iterator>
+#endif
+
+Mapping::Mapping(const char* file, bool sequential) : bytes(nullptr), length(0) {
+#if PIET_MMAP
+	const int descriptor = open(file, O_RDONLY);
+	struct stat status;
+	
+	if(descriptor < 0 || fstat(descriptor, &status) != 0) {
+		if(descriptor >= 0) {
+			close(descriptor);
+		}
+		
+		throw std::runtime_error(std::string("cannot open ") + file);
+	}
+	
+	length = status.st_size;
+	
+	if(length > 0) {
+		void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+		
+		if(mapped == MAP_FAILED) {
+			close(descriptor);
+			throw std::runtime_error(std::string("cannot map ") + file);
+		}
+		
+		madvise(mapped, length, sequential ? MADV_SEQUENTIAL : MADV_WILLNEED);
+		bytes = static_cast<const unsigned char*>(mapped);
+	}
+	
+	close(descriptor);
+#else
+	std::ifstream stream(file, std::ios::binary);
+	
+	if(!stream) {
+		throw std::runtime_error(std::string("cannot open ") + file);
+	}
+	
+	contents.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+	bytes = contents.data();
+	length = contents.size();
+#endif
+}
+
+Mapping::~Mapping() {
+#if PIET_MMAP
+	if(bytes) {
+		munmap(const_cast<unsigned char*>(bytes), length);
+	}
+#endif
+}
@@ -0,0 +1,31 @@
+#ifndef PIET_MAPPING_H
+#define PIET_MAPPING_H
+
+#include <cstddef>
+#include <vector>
+
+// A whole file mapped into memory read only, or read into it where files cannot be mapped. Throws std::runtime_error if the file cannot be opened
+class Mapping {
+public:
+	// Sequential tells the system the file will mostly be read from start to end
+	explicit Mapping(const char* file, bool sequential = true);
+	
+	Mapping(const Mapping&) = delete;
+	
+	~Mapping();
+	
+	const unsigned char* data() const {
+		return bytes;
+	}
+	
+	std::size_t size() const {
+		return length;
+	}
+
+private:
+	const unsigned char* bytes;
+	std::size_t length;
+	std::vector<unsigned char> contents;
+};
+
+#endif //PIET_MAPPING_H
@@ -0,0 +1,128 @@
+#include "netpbm.h"
+
+#include "classify.h"
+
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// The next word of a header, skipping white space and comments that run from # to the end of the line
+std::string word(const unsigned char* data, std::size_t length, std::size_t& position) {
+	while(position < length && (std::isspace(data[position]) || data[position] == '#')) {
+		if(data[position] == '#') {
+			while(position < length && data[position] != '\n') {
+				position++;
+			}
+		} else {
+			position++;
+		}
+	}
+	
+	const std::size_t start = position;
+	
+	while(position < length && !std::isspace(data[position])) {
+		position++;
+	}
+	
+	return std::string(data + start, data + position);
+}
+
+// A header number, 0 if the word is not one or is larger than limit
+std::uint64_t number(const std::string& word, std::uint64_t limit) {
+	std::uint64_t value = 0;
+	
+	for(const char digit : word) {
+		if(!std::isdigit(static_cast<unsigned char>(digit))) return 0;
+		
+		value = value * 10 + (digit - '0');
+		
+		if(value > limit) return 0;
+	}
+	
+	return value;
+}
+
+Netpbm::Netpbm(const char* image, int codel_size) : file(image), codel_size(codel_size), maximum(0) {
+	const unsigned char* data = file.data();
+	const std::size_t length = file.size();
+	
+	if(length < 3 || data[0] != 'P' || (data[1] != '5' && data[1] != '6' && data[1] != '7') || !std::isspace(data[2])) {
+		throw std::runtime_error(std::string(image) + " is not a binary netpbm image");
+	}
+	
+	std::size_t position = 2;
+	std::uint64_t width = 0;
+	std::uint64_t height = 0;
+	std::uint64_t depth = data[1] == '5' ? 1 : 3;
+	
+	if(data[1] == '7') {
+		// Lines of a name and a value, the tuple type is not needed since the depth says enough
+		for(std::string name = word(data, length, position); name != "ENDHDR"; name = word(data, length, position)) {
+			const std::string value = word(data, length, position);
+			
+			if(name.empty() || value.empty()) {
+				throw std::runtime_error(std::string(image) + " is truncated");
+			} else if(name == "WIDTH") {
+				width = number(value, INT32_MAX);
+			} else if(name == "HEIGHT") {
+				height = number(value, INT32_MAX);
+			} else if(name == "DEPTH") {
+				depth = number(value, 4);
+			} else if(name == "MAXVAL") {
+				maximum = number(value, 65535);
+			}
+		}
+	} else {
+		width = number(word(data, length, position), INT32_MAX);
+		height = number(word(data, length, position), INT32_MAX);
+		maximum = number(word(data, length, position), 65535);
+	}
+	
+	// One white space character separates the header from the samples
+	offset = position + 1;
+	channels = depth;
+	bytes = maximum > 255 ? 2 : 1;
+	stride = width * depth * bytes;
+	
+	if(width == 0 || height == 0 || depth == 0 || maximum == 0) {
+		throw std::runtime_error(std::string(image) + " has a corrupt header");
+	}
+	
+	if(offset > length || height > (length - offset) / stride) {
+		throw std::runtime_error(std::string(image) + " is truncated");
+	}
+	
+	for(int level = 0; level < 256; level++) {
+		scaled[level] = std::min<unsigned>(255, (level * 255 + maximum / 2) / maximum);
+		shades[level] = classify(level, level, level);
+	}
+	
+	columns = width / codel_size;
+	rows = height / codel_size;
+}
+
+void Netpbm::row(int y, unsigned char* colors) {
+	const unsigned char* samples = file.data() + offset + stride * (static_cast<std::uint64_t>(y) * codel_size + codel_size - 1);
+	const std::size_t step = static_cast<std::size_t>(codel_size) * channels;
+	
+	if(channels < 3) {
+		// Gray, possibly followed by alpha
+		for(int x = 0; x < columns; x++) {
+			colors[x] = shades[sample(samples, x * step)];
+		}
+		return;
+	}
+	
+	// Red, green and blue, possibly followed by alpha, are turned around into the order the classifier takes
+	std::vector<unsigned char> gathered(3 * static_cast<std::size_t>(columns));
+	
+	for(int x = 0; x < columns; x++) {
+		gathered[3 * x] = sample(samples, x * step + 2);
+		gathered[3 * x + 1] = sample(samples, x * step + 1);
+		gathered[3 * x + 2] = sample(samples, x * step);
+	}
+	
+	classify(gathered.data(), columns, colors);
+}
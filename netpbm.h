@@ -0,0 +1,42 @@
+#ifndef PIET_NETPBM_H
+#define PIET_NETPBM_H
+
+#include "image.h"
+#include "mapping.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// A binary netpbm file mapped into memory: P5 gray maps, P6 pixel maps and P7 arbitrary maps with one to four channels, of which only gray or red, green and blue are used. Samples of up to 16 bits are scaled to 8. Throws std::runtime_error for anything it cannot read
+class Netpbm : public Image {
+public:
+	Netpbm(const char* image, int codel_size);
+	
+	void row(int y, unsigned char* colors) override;
+	
+	bool random_access() const override {
+		return true;
+	}
+
+private:
+	// Sample i of a row, scaled to 8 bits
+	unsigned char sample(const unsigned char* samples, std::size_t i) const {
+		if(bytes == 1) return scaled[samples[i]];
+		
+		const unsigned value = samples[2 * i] << 8 | samples[2 * i + 1];
+		
+		return (value * 255 + maximum / 2) / maximum;
+	}
+	
+	Mapping file;
+	int codel_size;
+	std::uint64_t offset;      // Of the first row in the file
+	std::uint64_t stride;      // Bytes per row
+	int channels;
+	int bytes;                 // Per sample
+	unsigned maximum;          // Sample value
+	unsigned char scaled[256];    // Every 8 bit sample scaled to 255
+	unsigned char shades[256];    // Color code of every gray level
+};
+
+#endif //PIET_NETPBM_H
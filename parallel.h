@@ -0,0 +1,32 @@
+#ifndef PIET_PARALLEL_H
+#define PIET_PARALLEL_H
+
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Runs task(0) to task(threads - 1) at the same time and waits for all of them, the calling thread takes task 0
+template<typename Task>
+void parallel(unsigned threads, const Task& task) {
+	std::vector<std::thread> workers;
+	
+	for(unsigned thread = 1; thread < threads; thread++) {
+		workers.emplace_back(task, thread);
+	}
+	
+	task(0);
+	
+	for(std::thread& worker : workers) {
+		worker.join();
+	}
+}
+
+// Splits [0, count) into one contiguous range per thread and runs body(first, last) on each
+template<typename Body>
+void parallel_for(unsigned threads, std::size_t count, const Body& body) {
+	parallel(threads, [&](unsigned thread) {
+		body(count * thread / threads, count * (thread + 1) / threads);
+	});
+}
+
+#endif //PIET_PARALLEL_H
@@ -0,0 +1,289 @@
+#include "png.h"
+
+#include "classify.h"
+#include "program.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+
+// Big endian integer of four bytes, which is how png stores them
+std::uint32_t big_endian(const unsigned char* bytes) {
+	return static_cast<std::uint32_t>(bytes[0]) << 24 | bytes[1] << 16 | bytes[2] << 8 | bytes[3];
+}
+
+// Whichever of left, above and above left is closest to left + above - above left
+unsigned char paeth(int left, int above, int corner) {
+	const int estimate = left + above - corner;
+	const int to_left = std::abs(estimate - left);
+	const int to_above = std::abs(estimate - above);
+	const int to_corner = std::abs(estimate - corner);
+	
+	if(to_left <= to_above && to_left <= to_corner) return left;
+	if(to_above <= to_corner) return above;
+	
+	return corner;
+}
+
+Png::Png(const char* image, int codel_size)
+		: file(image, std::ios::binary), chunk(0), ended(false), inflater([this](unsigned char* buffer, std::size_t capacity) { return compressed(buffer, capacity); }), codel_size(codel_size), decoded(0), palette() {
+	const unsigned char signature[8] = {137, 'P', 'N', 'G', 13, 10, 26, 10};
+	unsigned char start[8];
+	
+	if(!file) {
+		throw std::runtime_error(std::string("cannot open ") + image);
+	}
+	
+	if(!file.read(reinterpret_cast<char*>(start), 8) || !std::equal(start, start + 8, signature)) {
+		throw std::runtime_error(std::string(image) + " is not a png");
+	}
+	
+	// Everything needed to decode the pixels comes before the first image data chunk
+	bool described = false;
+	std::vector<unsigned char> entries;
+	
+	while(true) {
+		if(!file.read(reinterpret_cast<char*>(start), 8)) {
+			throw std::runtime_error(std::string(image) + " is truncated");
+		}
+		
+		const std::uint32_t length = big_endian(start);
+		const std::string name(start + 4, start + 8);
+		
+		if(name == "IDAT") {
+			chunk = length;
+			break;
+		}
+		
+		if(name == "IHDR" || name == "PLTE") {
+			std::vector<unsigned char> data(std::min<std::uint32_t>(length, 3 * 256));
+			
+			if(length != (name == "IHDR" ? 13 : data.size()) || !file.read(reinterpret_cast<char*>(data.data()), data.size())) {
+				throw std::runtime_error(std::string(image) + " is corrupt");
+			}
+			
+			if(name == "IHDR") {
+				pixel_width = big_endian(&data[0]);
+				pixel_height = big_endian(&data[4]);
+				depth = data[8];
+				type = data[9];
+				interlaced = data[12] == 1;
+				
+				// Which depths every color type allows
+				const unsigned depths[7] = {1 | 2 | 4 | 8 | 16, 0, 8 | 16, 1 | 2 | 4 | 8, 8 | 16, 0, 8 | 16};
+				
+				if(pixel_width - 1 > INT32_MAX - 1 || pixel_height - 1 > INT32_MAX - 1 || type > 6 || !(depths[type] & depth) || (depth & (depth - 1)) != 0 || data[10] != 0 || data[11] != 0 || data[12] > 1) {
+					throw std::runtime_error(std::string(image) + " uses an unsupported pixel format");
+				}
+				
+				described = true;
+			} else {
+				entries = data;
+			}
+		} else if(name == "IEND") {
+			throw std::runtime_error(std::string(image) + " has no image data");
+		} else {
+			file.seekg(length, std::ios::cur);
+		}
+		
+		// Checksum
+		file.seekg(4, std::ios::cur);
+	}
+	
+	if(!described || (type == 3 && entries.empty())) {
+		throw std::runtime_error(std::string(image) + " is corrupt");
+	}
+	
+	const int channel_counts[7] = {1, 0, 3, 1, 2, 0, 4};
+	
+	channels = channel_counts[type];
+	filter_step = std::max(1, channels * depth / 8);
+	
+	// Palettes and gray levels are classified once, indices past the end of a palette are black
+	std::fill(palette, palette + 256, BLACK);
+	
+	if(type == 3) {
+		for(std::size_t i = 0; i + 3 <= entries.size(); i += 3) {
+			palette[i / 3] = classify(entries[i], entries[i + 1], entries[i + 2]);
+		}
+	} else if(type == 0 || type == 4) {
+		// Gray deeper than 8 bits is looked up by its high byte
+		const int levels = depth < 8 ? 1 << depth : 256;
+		
+		for(int level = 0; level < levels; level++) {
+			const int gray = level * 255 / (levels - 1);
+			
+			palette[level] = classify(gray, gray, gray);
+		}
+	}
+	
+	const std::size_t row_size = (static_cast<std::uint64_t>(pixel_width) * channels * depth + 7) / 8 + 1;
+	
+	current.resize(row_size);
+	previous.resize(row_size);
+	
+	columns = pixel_width / codel_size;
+	rows = pixel_height / codel_size;
+	gathered.resize(3 * static_cast<std::size_t>(columns) + 3);
+}
+
+std::size_t Png::compressed(unsigned char* buffer, std::size_t capacity) {
+	while(chunk == 0) {
+		if(ended) return 0;
+		
+		// The checksum of the chunk that just ran out, then the length and name of the next one
+		unsigned char start[12];
+		
+		if(!file.read(reinterpret_cast<char*>(start), 12)) {
+			throw std::runtime_error("image data is truncated");
+		}
+		
+		if(std::string(start + 8, start + 12) != "IDAT") {
+			ended = true;
+			return 0;
+		}
+		
+		chunk = big_endian(&start[4]);
+	}
+	
+	const std::size_t size = std::min<std::size_t>(capacity, chunk);
+	
+	if(!file.read(reinterpret_cast<char*>(buffer), size)) {
+		throw std::runtime_error("image data is truncated");
+	}
+	
+	chunk -= size;
+	
+	return size;
+}
+
+const unsigned char* Png::scanline(std::uint32_t width) {
+	const std::size_t size = (static_cast<std::uint64_t>(width) * channels * depth + 7) / 8;
+	
+	inflater.read(current.data(), size + 1);
+	
+	// Every row starts with the filter that was applied to it
+	unsigned char* line = &current[1];
+	const unsigned char* above = &previous[1];
+	const std::size_t step = filter_step;
+	
+	switch(current[0]) {
+		case 0:
+			break;
+		case 1:
+			for(std::size_t i = step; i < size; i++) {
+				line[i] += line[i - step];
+			}
+			break;
+		case 2:
+			for(std::size_t i = 0; i < size; i++) {
+				line[i] += above[i];
+			}
+			break;
+		case 3:
+			for(std::size_t i = 0; i < size; i++) {
+				line[i] += ((i >= step ? line[i - step] : 0) + above[i]) / 2;
+			}
+			break;
+		case 4:
+			for(std::size_t i = 0; i < size; i++) {
+				line[i] += i >= step ? paeth(line[i - step], above[i], above[i - step]) : above[i];
+			}
+			break;
+		default:
+			throw std::runtime_error("image data is corrupt");
+	}
+	
+	std::swap(current, previous);
+	
+	return &previous[1];
+}
+
+void Png::convert(const unsigned char* pixels, std::uint64_t first, std::uint64_t step, int count, unsigned char* colors) {
+	if(type == 2 || type == 6) {
+		// Deeper channels are classified by their high byte, which comes first
+		const std::size_t bytes = channels * depth / 8;
+		const std::size_t sample = depth / 8;
+		
+		for(int i = 0; i < count; i++) {
+			const unsigned char* pixel = &pixels[(first + i * step) * bytes];
+			
+			gathered[3 * i] = pixel[2 * sample];
+			gathered[3 * i + 1] = pixel[sample];
+			gathered[3 * i + 2] = pixel[0];
+		}
+		
+		classify(gathered.data(), count, colors);
+	} else if(depth < 8) {
+		// The leftmost pixel sits in the highest bits of a byte
+		const unsigned mask = (1u << depth) - 1;
+		
+		for(int i = 0; i < count; i++) {
+			const std::uint64_t position = (first + i * step) * depth;
+			
+			colors[i] = palette[pixels[position / 8] >> (8 - depth - position % 8) & mask];
+		}
+	} else {
+		const std::size_t bytes = channels * depth / 8;
+		
+		for(int i = 0; i < count; i++) {
+			colors[i] = palette[pixels[(first + i * step) * bytes]];
+		}
+	}
+}
+
+void Png::deinterlace() {
+	// Where the pixels of each pass start and how far apart they are
+	const int start_x[7] = {0, 4, 0, 2, 0, 1, 0};
+	const int start_y[7] = {0, 0, 4, 0, 2, 0, 1};
+	const int step_x[7] = {8, 8, 4, 4, 2, 2, 1};
+	const int step_y[7] = {8, 8, 8, 4, 4, 2, 2};
+	
+	codes.assign(static_cast<std::size_t>(columns) * rows, BLACK);
+	
+	for(int pass = 0; pass < 7; pass++) {
+		if(pixel_width <= static_cast<std::uint32_t>(start_x[pass]) || pixel_height <= static_cast<std::uint32_t>(start_y[pass])) continue;
+		
+		const std::uint32_t width = (pixel_width - start_x[pass] + step_x[pass] - 1) / step_x[pass];
+		const std::uint32_t height = (pixel_height - start_y[pass] + step_y[pass] - 1) / step_y[pass];
+		
+		// Filters do not look back into the previous pass
+		std::fill(previous.begin(), previous.end(), 0);
+		
+		for(std::uint32_t j = 0; j < height; j++) {
+			const unsigned char* pixels = scanline(width);
+			const std::uint64_t y = start_y[pass] + static_cast<std::uint64_t>(j) * step_y[pass];
+			
+			if(y % codel_size != static_cast<std::uint64_t>(codel_size - 1) || y / codel_size >= static_cast<std::uint64_t>(rows)) continue;
+			
+			for(std::uint32_t i = 0; i < width; i++) {
+				const std::uint64_t x = start_x[pass] + static_cast<std::uint64_t>(i) * step_x[pass];
+				
+				if(x % codel_size == 0 && x / codel_size < static_cast<std::uint64_t>(columns)) {
+					convert(pixels, i, 1, 1, &codes[y / codel_size * columns + x / codel_size]);
+				}
+			}
+		}
+	}
+}
+
+void Png::row(int y, unsigned char* colors) {
+	if(interlaced) {
+		if(decoded == 0) {
+			deinterlace();
+			decoded = pixel_height;
+		}
+		
+		std::copy(codes.begin() + static_cast<std::size_t>(y) * columns, codes.begin() + static_cast<std::size_t>(y + 1) * columns, colors);
+		return;
+	}
+	
+	// The rows in between still have to be decoded, later rows are filtered against them
+	while(decoded <= static_cast<std::uint32_t>(y) * codel_size + codel_size - 1) {
+		scanline(pixel_width);
+		decoded++;
+	}
+	
+	convert(&previous[1], 0, codel_size, columns, colors);
+}
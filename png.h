@@ -0,0 +1,53 @@
+#ifndef PIET_PNG_H
+#define PIET_PNG_H
+
+#include "image.h"
+#include "inflate.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+// A png file decompressed while its rows are read. Only the pixel row being decoded and the one before it are kept, since filters refer back to it. Takes every color type and bit depth, alpha is ignored. Interlaced images spread every row over seven passes, so those are decoded in one go into a color per codel. Throws std::runtime_error for anything it cannot read
+class Png : public Image {
+public:
+	Png(const char* image, int codel_size);
+	
+	void row(int y, unsigned char* colors) override;
+
+private:
+	// Compressed data from the image data chunks, which together hold one zlib stream
+	std::size_t compressed(unsigned char* buffer, std::size_t capacity);
+	
+	// Decodes the next pixel row of width pixels and returns its pixels
+	const unsigned char* scanline(std::uint32_t width);
+	
+	// Classifies count pixels of a row, starting at pixel first and stepping over step pixels
+	void convert(const unsigned char* pixels, std::uint64_t first, std::uint64_t step, int count, unsigned char* colors);
+	
+	void deinterlace();
+	
+	std::ifstream file;
+	std::uint32_t chunk;    // Bytes left in the current image data chunk
+	bool ended;             // Past the last image data chunk
+	Inflater inflater;
+	
+	int codel_size;
+	std::uint32_t pixel_width;
+	std::uint32_t pixel_height;
+	int depth;              // Bits per channel
+	int type;
+	int channels;
+	bool interlaced;
+	int filter_step;        // Bytes in a pixel, at least 1, which is how far back filters look
+	
+	std::vector<unsigned char> current;
+	std::vector<unsigned char> previous;
+	std::uint32_t decoded;  // Pixel rows so far
+	unsigned char palette[256];    // Color code of every palette entry or gray level
+	std::vector<unsigned char> gathered;
+	std::vector<unsigned char> codes;    // Of every codel of an interlaced image
+};
+
+#endif //PIET_PNG_H
@@ -0,0 +1,433 @@
+#include "program.h"
+
+#include "image.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+// Unit steps for each direction pointer value: right, down, left and up
+const Position directions[4] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
+
+// Only used while loading, the Program keeps nothing but the sizes and exits. Exit dp * 2 + cc leaves from the codel furthest along dp, ties broken furthest towards the side cc points at
+struct Block {
+	unsigned char color;
+	std::uint32_t size;
+	Position exits[8];
+	std::uint32_t neighbors[8];    // Label of the codel each exit leads to
+};
+
+// Whether a codel lies beyond where an exit currently leaves from
+bool beyond(int exit, const Position& position, const Position& current) {
+	const Position dp = directions[exit / 2];
+	const Position cc = exit % 2 == 0 ? Position{dp.y, -dp.x} : Position{-dp.y, dp.x};
+	const int dx = position.x - current.x;
+	const int dy = position.y - current.y;
+	const int forward = dx * dp.x + dy * dp.y;
+	
+	return forward > 0 || (forward == 0 && dx * cc.x + dy * cc.y > 0);
+}
+
+// A block without codels yet, whose exits all start out at its first codel
+Block empty_block(unsigned char color, const Position& start) {
+	Block block{};
+	
+	block.color = color;
+	std::fill(block.exits, block.exits + 8, start);
+	
+	return block;
+}
+
+// Adds a codel to a block, moving every exit it lies beyond
+void extend(Block& block, const Position& position) {
+	block.size++;
+	
+	for(int exit = 0; exit < 8; exit++) {
+		if(beyond(exit, position, block.exits[exit])) {
+			block.exits[exit] = position;
+		}
+	}
+}
+
+// Adds the codels of another summary of the same block
+void merge(Block& block, const Block& other) {
+	block.size += other.size;
+	
+	for(int exit = 0; exit < 8; exit++) {
+		if(beyond(exit, other.exits[exit], block.exits[exit])) {
+			block.exits[exit] = other.exits[exit];
+			block.neighbors[exit] = other.neighbors[exit];
+		}
+	}
+}
+
+// What a loaded Program owns
+struct Arrays {
+	std::vector<std::uint32_t> successors;
+	std::vector<Opcode> opcodes;
+	std::vector<std::uint32_t> sizes;
+	std::vector<unsigned char> colors;
+};
+
+Program::Program(std::vector<std::uint32_t> successors, std::vector<Opcode> opcodes, std::vector<std::uint32_t> sizes, std::vector<unsigned char> colors) {
+	const std::shared_ptr<Arrays> arrays = std::make_shared<Arrays>(Arrays{std::move(successors), std::move(opcodes), std::move(sizes), std::move(colors)});
+	
+	*this = Program(arrays, arrays->sizes.size(), arrays->successors.data(), arrays->opcodes.data(), arrays->sizes.data(), arrays->colors.data());
+}
+
+Program::Program(std::shared_ptr<const void> storage, unsigned count, const std::uint32_t* successors, const Opcode* opcodes, const std::uint32_t* sizes, const unsigned char* colors)
+		: storage(std::move(storage)), count(count), successors(successors), opcodes(opcodes), sizes(sizes), colors(colors) {}
+
+const std::uint32_t UNLABELED = UINT32_MAX;
+const std::uint32_t OUTSIDE = UINT32_MAX;    // Neighbor of exits that leave the image
+
+// Looks up the block a codel belongs to, codels beyond the image give outside
+unsigned find_block(const Position& pos, const std::vector<std::uint32_t>& labels, int width, int height, unsigned outside) {
+	if(pos.x < 0 || pos.y < 0 || pos.x >= width || pos.y >= height) return outside;
+	
+	return labels[pos.y * width + pos.x];
+}
+
+// Strips thinner than this, or fewer blocks per thread than that, cost more in threads than they save
+const int MIN_STRIP_ROWS = 32;
+const unsigned MIN_THREAD_BLOCKS = 4096;
+
+// Two neighboring codels are in the same block when their colors match, except white which is a block per codel. White pixels should be color blocks on their own, even when their neighbors are also white, because that allows us to "slide across" them without adding code
+bool connected(unsigned char a, unsigned char b) {
+	return a == b && a != WHITE;
+}
+
+// Root of a provisional label in the streaming labeler, halving the path on the way
+std::uint32_t find(std::vector<std::uint32_t>& parents, std::uint32_t label) {
+	while(parents[label] != label) {
+		parents[label] = parents[parents[label]];
+		label = parents[label];
+	}
+	
+	return label;
+}
+
+// Labels the image one codel row at a time and keeps nothing of earlier rows but the labels of the one above. Runs of codels get provisional labels that are joined with a union-find once they turn out to touch, and every root holds the summary of everything joined to it. Exits look up their neighbor as soon as they move, except the ones going down, which wait for the next row
+void stream_blocks(Image& source, std::vector<Block>& blocks) {
+	const int width = source.width();
+	const int height = source.height();
+	
+	std::vector<unsigned char> above(width);
+	std::vector<unsigned char> colors(width);
+	std::vector<std::uint32_t> up(width);
+	std::vector<std::uint32_t> labels(width);
+	
+	// Until the end blocks holds a summary per provisional label
+	std::vector<std::uint32_t> parents;
+	
+	for(int y = 0; y < height; y++) {
+		source.row(y, colors.data());
+		
+		for(int x = 0; x < width; x++) {
+			const bool left = x > 0 && connected(colors[x], colors[x - 1]);
+			const bool over = y > 0 && connected(colors[x], above[x]);
+			
+			if(left) {
+				labels[x] = labels[x - 1];
+			} else if(over) {
+				labels[x] = up[x];
+			} else {
+				labels[x] = parents.size();
+				parents.push_back(labels[x]);
+				blocks.push_back(empty_block(colors[x], {x, y}));
+			}
+			
+			// The root with the lower label started first, so it keeps the summary
+			if(left && over) {
+				std::uint32_t a = find(parents, labels[x]);
+				std::uint32_t b = find(parents, up[x]);
+				
+				if(a > b) std::swap(a, b);
+				
+				if(a != b) {
+					parents[b] = a;
+					merge(blocks[a], blocks[b]);
+				}
+			}
+		}
+		
+		for(int x = 0; y > 0 && x < width; x++) {
+			Block& block = blocks[find(parents, up[x])];
+			
+			for(int exit = 2; exit < 4; exit++) {
+				if(block.exits[exit].x == x && block.exits[exit].y == y - 1) {
+					block.neighbors[exit] = labels[x];
+				}
+			}
+		}
+		
+		for(int x = 0; x < width; x++) {
+			Block& block = blocks[find(parents, labels[x])];
+			
+			extend(block, {x, y});
+			
+			for(int exit = 0; exit < 8; exit++) {
+				if(block.exits[exit].x == x && block.exits[exit].y == y) {
+					switch(exit / 2) {
+						case 0:
+							block.neighbors[exit] = x + 1 < width ? labels[x + 1] : OUTSIDE;
+							break;
+						case 1:
+							block.neighbors[exit] = OUTSIDE;
+							break;
+						case 2:
+							block.neighbors[exit] = x > 0 ? labels[x - 1] : OUTSIDE;
+							break;
+						default:
+							block.neighbors[exit] = y > 0 ? up[x] : OUTSIDE;
+					}
+				}
+			}
+		}
+		
+		std::swap(above, colors);
+		std::swap(up, labels);
+	}
+	
+	// Number the roots in the order they started, which is the order their first codels are met. A root never moves up, so the summaries can be compacted in place
+	std::vector<std::uint32_t> numbers(parents.size());
+	std::uint32_t count = 0;
+	
+	for(std::uint32_t label = 0; label < parents.size(); label++) {
+		if(find(parents, label) == label) {
+			numbers[label] = count;
+			blocks[count++] = blocks[label];
+		}
+	}
+	
+	blocks.resize(count);
+	
+	for(Block& block : blocks) {
+		for(std::uint32_t& neighbor : block.neighbors) {
+			if(neighbor != OUTSIDE) {
+				neighbor = numbers[find(parents, neighbor)];
+			}
+		}
+	}
+}
+
+// Root of a codel's component, halving the path on the way. Other threads may be doing the same, so parents only ever move to an ancestor
+std::uint32_t find(std::vector<std::atomic<std::uint32_t>>& parents, std::uint32_t codel) {
+	while(true) {
+		std::uint32_t parent = parents[codel].load(std::memory_order_relaxed);
+		
+		if(parent == codel) return codel;
+		
+		const std::uint32_t grandparent = parents[parent].load(std::memory_order_relaxed);
+		
+		if(grandparent != parent) {
+			parents[codel].compare_exchange_weak(parent, grandparent, std::memory_order_relaxed);
+		}
+		
+		codel = grandparent;
+	}
+}
+
+// Joins two components without locks. The root with the higher index is linked below the other, so a component's root is always its first codel in scan order
+void unite(std::vector<std::atomic<std::uint32_t>>& parents, std::uint32_t a, std::uint32_t b) {
+	while(true) {
+		a = find(parents, a);
+		b = find(parents, b);
+		
+		if(a == b) return;
+		
+		if(a < b) std::swap(a, b);
+		
+		// Fails when another thread linked a somewhere in the meantime, then try again from the new roots
+		std::uint32_t expected = a;
+		
+		if(parents[a].compare_exchange_strong(expected, b, std::memory_order_acq_rel)) return;
+	}
+}
+
+// Labels the codels in horizontal strips at the same time with a union-find over codel indices, then joins the components that cross strip borders. Blocks are numbered by their root, which is their first codel, so labels and summaries come out exactly like stream_blocks makes them
+void label_strips(const std::vector<unsigned char>& colors, int width, int height, std::vector<std::uint32_t>& labels, std::vector<Block>& blocks, unsigned threads) {	
+	const auto first_row = [&](unsigned strip) {
+		return static_cast<int>(static_cast<long long>(height) * strip / threads);
+	};
+	
+	std::vector<std::atomic<std::uint32_t>> parents(labels.size());
+	
+	parallel(threads, [&](unsigned strip) {
+		for(int y = first_row(strip); y < first_row(strip + 1); y++) {
+			for(int x = 0; x < width; x++) {
+				const std::uint32_t codel = y * width + x;
+				
+				parents[codel].store(codel, std::memory_order_relaxed);
+				
+				if(x > 0 && connected(colors[codel], colors[codel - 1])) {
+					unite(parents, codel - 1, codel);
+				}
+				
+				if(y > first_row(strip) && connected(colors[codel], colors[codel - width])) {
+					unite(parents, codel - width, codel);
+				}
+			}
+		}
+	});
+	
+	// Both strips next to a border are finished, only their roots can still be linked by two threads at once
+	parallel(threads, [&](unsigned strip) {
+		if(strip == 0) return;
+		
+		const int y = first_row(strip);
+		
+		for(int x = 0; x < width; x++) {
+			if(connected(colors[y * width + x], colors[(y - 1) * width + x])) {
+				unite(parents, (y - 1) * width + x, y * width + x);
+			}
+		}
+	});
+	
+	// Point every codel straight at its root and count the roots, which tells each strip where its block numbers start
+	std::vector<std::uint32_t> firsts(threads + 1, 0);
+	
+	parallel(threads, [&](unsigned strip) {
+		std::uint32_t roots = 0;
+		
+		const std::uint32_t end = static_cast<std::uint32_t>(first_row(strip + 1)) * width;
+		
+		for(std::uint32_t codel = static_cast<std::uint32_t>(first_row(strip)) * width; codel < end; codel++) {
+			const std::uint32_t root = find(parents, codel);
+			
+			parents[codel].store(root, std::memory_order_relaxed);
+			roots += root == codel;
+		}
+		
+		firsts[strip + 1] = roots;
+	});
+	
+	for(unsigned strip = 0; strip < threads; strip++) {
+		firsts[strip + 1] += firsts[strip];
+	}
+	
+	blocks.resize(firsts[threads]);
+	
+	parallel(threads, [&](unsigned strip) {
+		std::uint32_t next = firsts[strip];
+		
+		for(int y = first_row(strip); y < first_row(strip + 1); y++) {
+			for(int x = 0; x < width; x++) {
+				const std::uint32_t codel = y * width + x;
+				
+				if(parents[codel].load(std::memory_order_relaxed) == codel) {
+					labels[codel] = next;
+					blocks[next++] = empty_block(colors[codel], {x, y});
+				}
+			}
+		}
+	});
+	
+	// A strip owns the blocks whose root it contains. Blocks that started in an earlier strip are summarized on the side and merged afterwards
+	std::vector<std::unordered_map<std::uint32_t, Block>> crossing(threads);
+	
+	parallel(threads, [&](unsigned strip) {
+		const std::uint32_t owned = first_row(strip) * width;
+		
+		for(int y = first_row(strip); y < first_row(strip + 1); y++) {
+			for(int x = 0; x < width; x++) {
+				const std::uint32_t codel = y * width + x;
+				const std::uint32_t root = parents[codel].load(std::memory_order_relaxed);
+				
+				if(root != codel) {
+					labels[codel] = labels[root];
+				}
+				
+				if(root >= owned) {
+					extend(blocks[labels[codel]], {x, y});
+				} else {
+					extend(crossing[strip].emplace(root, empty_block(colors[codel], {x, y})).first->second, {x, y});
+				}
+			}
+		}
+	});
+	
+	for(unsigned strip = 0; strip < threads; strip++) {
+		for(const auto& summary : crossing[strip]) {
+			merge(blocks[labels[summary.first]], summary.second);
+		}
+	}
+}
+
+Program load_image(const char* image, const int codel_size, unsigned threads) {
+	const std::unique_ptr<Image> source = open_image(image, codel_size);
+	
+	const int width = source->width();
+	const int height = source->height();
+	
+	// Execution starts in the top left codel, so there has to be one
+	if(width == 0 || height == 0) {
+		throw std::runtime_error(std::string(image) + " is smaller than one codel");
+	}
+	
+	// Find Color blocks, numbered in the order their first codel is met. One thread streams the image, more threads need all of it at once
+	
+	std::vector<Block> blocks;
+	
+	const unsigned strips = std::max(1, std::min(static_cast<int>(threads), height / MIN_STRIP_ROWS));
+	
+	if(strips > 1) {
+		std::vector<unsigned char> colors(static_cast<std::size_t>(width) * height);
+		std::vector<std::uint32_t> labels(static_cast<std::size_t>(width) * height);
+		
+		// Compressed images can only be decoded from top to bottom
+		parallel_for(source->random_access() ? strips : 1, height, [&](std::size_t first, std::size_t last) {
+			for(std::size_t y = first; y < last; y++) {
+				source->row(y, &colors[y * width]);
+			}
+		});
+		
+		label_strips(colors, width, height, labels, blocks, strips);
+		
+		// Each exit leads to the codel one step along dp from where it leaves. Every block only writes its own exits, so the blocks are split over the threads
+		parallel_for(std::max(1u, std::min(threads, static_cast<unsigned>(blocks.size()) / MIN_THREAD_BLOCKS)), blocks.size(), [&](std::size_t first, std::size_t last) {
+			for(std::size_t i = first; i < last; i++) {
+				for(int exit = 0; exit < 8; exit++) {
+					const Position& leaving = blocks[i].exits[exit];
+					
+					blocks[i].neighbors[exit] = find_block({leaving.x + directions[exit / 2].x, leaving.y + directions[exit / 2].y}, labels, width, height, OUTSIDE);
+				}
+			}
+		});
+	} else {
+		stream_blocks(*source, blocks);
+	}
+	
+	// Flatten the graph
+	
+	const unsigned count = blocks.size();
+	
+	std::vector<std::uint32_t> successors(count * 8);
+	std::vector<Opcode> opcodes(count * 8);
+	std::vector<std::uint32_t> sizes(count);
+	std::vector<unsigned char> codes(count);
+	
+	for(unsigned i = 0; i < count; i++) {
+		const unsigned char from = blocks[i].color;
+		
+		for(int exit = 0; exit < 8; exit++) {
+			const unsigned neighbor = blocks[i].neighbors[exit];
+			
+			// Anything outside the image is black
+			const unsigned char to = neighbor == OUTSIDE ? BLACK : blocks[neighbor].color;
+			
+			successors[i * 8 + exit] = to == BLACK ? i : neighbor;
+			opcodes[i * 8 + exit] = from == BLACK ? BLOCKED : transition(from, to);
+		}
+		
+		sizes[i] = blocks[i].size;
+		codes[i] = from;
+	}
+	
+	return Program(std::move(successors), std::move(opcodes), std::move(sizes), std::move(codes));
+}
@@ -0,0 +1,116 @@
+#ifndef PIET_PROGRAM_H
+#define PIET_PROGRAM_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// LIGHT NONE is white and DARK NONE is black, NORMAL NONE is undefined
+enum Hue {
+	RED = 0, YELLOW = 1, GREEN = 2, CYAN = 3, BLUE = 4, MAGENTA = 5, NONE = 6
+};
+
+enum Lightness {
+	LIGHT = 0, NORMAL = 1, DARK = 2
+};
+
+struct Color {
+	Lightness lightness;
+	Hue hue;
+};
+
+struct Position {
+	int x;
+	int y;
+};
+
+// Colors packed into a byte: lightness * 6 + hue for the 18 hued colors, followed by white and black
+const unsigned char WHITE = 18;
+const unsigned char BLACK = 19;
+
+constexpr unsigned char color_code(Color color) {
+	return color.hue != NONE ? color.lightness * 6 + color.hue : color.lightness == LIGHT ? WHITE : BLACK;
+}
+
+// Ordered like the commands table in the Piet specification, so a hued transition is lightness change * 6 + hue change
+enum Opcode : unsigned char {
+	SKIP, ADD, DIVIDE, GREATER, DUPLICATE, IN_CHAR,
+	PUSH, SUBTRACT, MOD, POINTER, ROLL, OUT_NUMBER,
+	POP, MULTIPLY, NOT, SWITCH, IN_NUMBER, OUT_CHAR,
+	BLOCKED    // Bumped into a black block or fell off the edge
+};
+
+// Opcode of every transition between two color codes
+struct TransitionTable {
+	Opcode opcodes[20][20];
+	
+	constexpr TransitionTable() : opcodes() {
+		for(int from = 0; from < 20; from++) {
+			for(int to = 0; to < 20; to++) {
+				if(to == BLACK) {
+					opcodes[from][to] = BLOCKED;
+				} else if(from >= WHITE || to == WHITE) {
+					// Either going to or coming from a white Color Block
+					opcodes[from][to] = SKIP;
+				} else {
+					opcodes[from][to] = static_cast<Opcode>((to / 6 - from / 6 + 3) % 3 * 6 + (to % 6 - from % 6 + 6) % 6);
+				}
+			}
+		}
+	}
+	
+	constexpr Opcode operator()(unsigned char from, unsigned char to) const {
+		return opcodes[from][to];
+	}
+};
+
+constexpr TransitionTable transition;
+
+// The compiled block graph of an image, stored as one array per field. Exit dp * 2 + cc of block i lives at index i * 8 + dp * 2 + cc. It is never modified after loading, so any number of VMs can run it at once, and copies share the arrays
+class Program {
+public:
+	Program(std::vector<std::uint32_t> successors, std::vector<Opcode> opcodes, std::vector<std::uint32_t> sizes, std::vector<unsigned char> colors);
+	
+	// Runs straight from arrays that storage keeps alive, such as a mapped cache file, without copying them
+	Program(std::shared_ptr<const void> storage, unsigned count, const std::uint32_t* successors, const Opcode* opcodes, const std::uint32_t* sizes, const unsigned char* colors);
+	
+	unsigned block_count() const {
+		return count;
+	}
+	
+	// Block reached through an exit. Blocked exits lead back to the block itself
+	std::uint32_t successor(unsigned block, unsigned exit) const {
+		return successors[block * 8 + exit];
+	}
+	
+	Opcode opcode(unsigned block, unsigned exit) const {
+		return opcodes[block * 8 + exit];
+	}
+	
+	// Number of codels in a block, which is what push pushes
+	std::uint32_t block_size(unsigned block) const {
+		return sizes[block];
+	}
+	
+	unsigned char color(unsigned block) const {
+		return colors[block];
+	}
+	
+	// The block containing the top left codel
+	unsigned start() const {
+		return 0;
+	}
+
+private:
+	std::shared_ptr<const void> storage;
+	unsigned count;
+	const std::uint32_t* successors;
+	const Opcode* opcodes;
+	const std::uint32_t* sizes;
+	const unsigned char* colors;
+};
+
+// Labels blocks with up to the given number of threads, which gives the same Program as one thread. One thread streams the image with memory proportional to its width, more hold all of it at 5 bytes per codel. Throws std::runtime_error for images it cannot read
+Program load_image(const char* image, int codel_size, unsigned threads = 1);
+
+#endif //PIET_PROGRAM_H
@@ -0,0 +1,296 @@
+#include "propagate.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// How many values below the top are tracked
+const std::size_t DEPTH = 8;
+
+struct Value {
+	bool known;
+	std::int32_t value;
+	
+	bool operator==(const Value& other) const {
+		return known == other.known && (!known || value == other.value);
+	}
+};
+
+// What is certain about the stack at an address: the values that are definitely there, topmost last. Nothing is known about what lies below them
+struct State {
+	bool reached = false;
+	std::vector<Value> values;
+	
+	void push(Value value) {
+		if(values.size() == DEPTH) {
+			values.erase(values.begin());
+		}
+		
+		values.push_back(value);
+	}
+	
+	Value pop() {
+		Value value = values.back();
+		values.pop_back();
+		
+		return value;
+	}
+	
+	void forget() {
+		values.clear();
+	}
+	
+	// Keeps what holds on both paths, returns true if anything changed
+	bool merge(const State& other) {
+		if(!reached) {
+			*this = other;
+			return true;
+		}
+		
+		const std::size_t common = std::min(values.size(), other.values.size());
+		bool changed = common != values.size();
+		
+		values.erase(values.begin(), values.end() - common);
+		
+		for(std::size_t i = 1; i <= common; i++) {
+			Value& value = values[values.size() - i];
+			
+			if(!(value == other.values[other.values.size() - i])) {
+				changed = changed || value.known;
+				value.known = false;
+			}
+		}
+		
+		return changed;
+	}
+};
+
+const Value UNKNOWN = {false, 0};
+
+// Only folds what every cell width agrees on, so results that overflow 32 bits stay unknown. Divisions that trap or do nothing are left to runtime
+bool fold(unsigned char op, std::int32_t a, std::int32_t b, std::int32_t& result) {
+	std::int64_t wide;
+	
+	switch(op) {
+		case ADD: wide = static_cast<std::int64_t>(a) + b; break;
+		case SUBTRACT: wide = static_cast<std::int64_t>(a) - b; break;
+		case MULTIPLY: wide = static_cast<std::int64_t>(a) * b; break;
+		case GREATER: wide = a > b; break;
+		case DIVIDE:
+		case MOD:
+			if(b == 0 || (a == INT32_MIN && b == -1)) return false;
+			
+			wide = op == DIVIDE ? a / b : (a % b + static_cast<std::int64_t>(b)) % b;
+			break;
+		default:
+			return false;
+	}
+	
+	if(wide < INT32_MIN || wide > INT32_MAX) return false;
+	
+	result = wide;
+	return true;
+}
+
+// Applies an instruction to the stack. POINTER and SWITCH pop their value before it is known where they go, so the caller handles those
+void transfer(const Instruction& instruction, State& state) {
+	switch(instruction.op) {
+		case PUSH:
+			state.push({true, static_cast<std::int32_t>(instruction.operand)});
+			break;
+		case IN_NUMBER:
+		case IN_CHAR:
+			state.push(UNKNOWN);
+			break;
+		case POP:
+		case OUT_NUMBER:
+		case OUT_CHAR:
+			// On an empty stack these do nothing, which leaves the state empty as well
+			if(!state.values.empty()) state.pop();
+			break;
+		case NOT:
+			if(state.values.empty()) break;
+			
+			state.values.back() = state.values.back().known ? Value{true, !state.values.back().value} : UNKNOWN;
+			break;
+		case DUPLICATE:
+			if(state.values.empty()) break;
+			
+			state.push(state.values.back());
+			break;
+		case ADD:
+		case SUBTRACT:
+		case MULTIPLY:
+		case DIVIDE:
+		case MOD:
+		case GREATER: {
+			if(state.values.size() < 2) {
+				state.forget();
+				break;
+			}
+			
+			const Value b = state.values.back();
+			const Value a = state.values[state.values.size() - 2];
+			std::int32_t result;
+			
+			if(a.known && b.known && fold(instruction.op, a.value, b.value, result)) {
+				state.pop();
+				state.values.back() = {true, result};
+			} else if((instruction.op == DIVIDE || instruction.op == MOD) && !(b.known && b.value != 0)) {
+				// Whether anything happens depends on b being zero
+				state.forget();
+			} else {
+				state.pop();
+				state.values.back() = UNKNOWN;
+			}
+			break;
+		}
+		case ADD_IMMEDIATE:
+		case SUBTRACT_IMMEDIATE:
+		case MULTIPLY_IMMEDIATE: {
+			if(state.values.empty()) {
+				state.forget();
+				break;
+			}
+			
+			const unsigned char op = instruction.op == ADD_IMMEDIATE ? ADD : instruction.op == SUBTRACT_IMMEDIATE ? SUBTRACT : MULTIPLY;
+			Value& top = state.values.back();
+			
+			if(!top.known || !fold(op, top.value, instruction.operand, top.value)) {
+				top = UNKNOWN;
+			}
+			break;
+		}
+		case SQUARE: {
+			if(state.values.empty()) break;
+			
+			Value& top = state.values.back();
+			
+			if(!top.known || !fold(MULTIPLY, top.value, top.value, top.value)) {
+				top = UNKNOWN;
+			}
+			break;
+		}
+		case JUMP:
+		case BRANCH_IMMEDIATE:
+		case HALT:
+			// Control flow only, the stack carries over to wherever it goes
+			break;
+		default:
+			state.forget();
+	}
+}
+
+// Every address the instruction at pc can continue at
+std::vector<std::uint32_t> successors(const Bytecode& bytecode, std::uint32_t pc) {
+	const Instruction& instruction = bytecode.instructions()[pc];
+	
+	switch(instruction.op) {
+		case JUMP:
+		case BRANCH_IMMEDIATE:
+			return {instruction.operand};
+		case HALT:
+			return {};
+		case POINTER:
+		case SWITCH: {
+			std::vector<std::uint32_t> addresses;
+			
+			for(unsigned exit = 0; exit < 8; exit++) {
+				const std::uint32_t entry = bytecode.entry(instruction.operand / 8 * 8 + exit);
+				
+				if(entry != UNCOMPILED) {
+					addresses.push_back(entry);
+				}
+			}
+			
+			return addresses;
+		}
+		default:
+			return {pc + 1};
+	}
+}
+
+Bytecode propagate(const Bytecode& bytecode, unsigned* resolved) {
+	const std::vector<Instruction>& code = bytecode.instructions();
+	
+	std::vector<State> states(code.size());
+	std::vector<std::uint32_t> pending = {bytecode.start()};
+	
+	states[bytecode.start()].reached = true;
+	
+	while(!pending.empty()) {
+		const std::uint32_t pc = pending.back();
+		pending.pop_back();
+		
+		State state = states[pc];
+		
+		if(code[pc].op == POINTER || code[pc].op == SWITCH) {
+			if(!state.values.empty()) state.pop();
+		} else {
+			transfer(code[pc], state);
+		}
+		
+		for(const std::uint32_t next : successors(bytecode, pc)) {
+			if(states[next].merge(state)) {
+				pending.push_back(next);
+			}
+		}
+	}
+	
+	// Every resolved branch grows by a POP, so addresses shift
+	std::vector<Instruction> propagated;
+	std::vector<std::uint32_t> blocks;
+	std::vector<std::uint32_t> addresses(code.size());
+	
+	if(resolved) {
+		*resolved = 0;
+	}
+	
+	for(std::uint32_t pc = 0; pc < code.size(); pc++) {
+		const Instruction& instruction = code[pc];
+		const State& state = states[pc];
+		
+		addresses[pc] = propagated.size();
+		
+		if((instruction.op == POINTER || instruction.op == SWITCH) && !state.values.empty() && state.values.back().known) {
+			const Location location = instruction.operand;
+			const std::uint32_t value = state.values.back().value;
+			unsigned dp = location / 2 % 4;
+			unsigned cc = location % 2;
+			
+			if(instruction.op == POINTER) {
+				dp = (dp + value) % 4;
+			} else {
+				cc = (cc + value) % 2;
+			}
+			
+			propagated.push_back({POP, 0});
+			propagated.push_back({JUMP, bytecode.entry(location / 8 * 8 + dp * 2 + cc)});
+			
+			if(resolved) {
+				(*resolved)++;
+			}
+		} else {
+			propagated.push_back(instruction);
+		}
+		
+		blocks.resize(propagated.size(), bytecode.block(pc));
+	}
+	
+	for(Instruction& instruction : propagated) {
+		if(instruction.op == JUMP || instruction.op == BRANCH_IMMEDIATE) {
+			instruction.operand = addresses[instruction.operand];
+		}
+	}
+	
+	std::vector<std::uint32_t> entries(bytecode.locations());
+	
+	for(Location location = 0; location < bytecode.locations(); location++) {
+		const std::uint32_t pc = bytecode.entry(location);
+		
+		entries[location] = pc == UNCOMPILED ? UNCOMPILED : addresses[pc];
+	}
+	
+	return Bytecode(std::move(propagated), std::move(entries), std::move(blocks));
+}
@@ -0,0 +1,9 @@
+#ifndef PIET_PROPAGATE_H
+#define PIET_PROPAGATE_H
+
+#include "bytecode.h"
+
+// Tracks which values on top of the stack are constants at every address. A POINTER or SWITCH that pops a constant always turns the same way, so it becomes a POP and a JUMP straight to the code for the new direction. Sets resolved to the number of branches rewritten
+Bytecode propagate(const Bytecode& bytecode, unsigned* resolved = nullptr);
+
+#endif //PIET_PROPAGATE_H
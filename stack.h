@@ -0,0 +1,61 @@
+#ifndef PIET_STACK_H
+#define PIET_STACK_H
+
+#include "cell.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Values in one contiguous buffer, topmost last. The buffer doubles when it fills up, so pushing is amortised constant time
+template<typename Cell>
+class Stack {
+public:
+	bool empty() const {
+		return values.empty();
+	}
+	
+	std::size_t size() const {
+		return values.size();
+	}
+	
+	Cell& top() {
+		return values.back();
+	}
+	
+	void push(const Cell& value) {
+		values.push_back(value);
+	}
+	
+	void push(Cell&& value) {
+		values.push_back(std::move(value));
+	}
+	
+	void pop() {
+		values.pop_back();
+	}
+	
+	// The bottom value, the rest follow it
+	const Cell* data() const {
+		return values.data();
+	}
+	
+	void assign(const Cell* first, const Cell* last) {
+		values.assign(first, last);
+	}
+	
+	// Buries the top value depth deep, count times, as a single rotation of the top depth values. A negative count digs values up instead. The stack has to hold at least depth values
+	void roll(std::size_t depth, const Cell& count) {
+		if(depth == 0) return;
+		
+		const std::size_t shift = residue(count, depth);
+		
+		std::rotate(values.end() - depth, values.end() - shift, values.end());
+	}
+
+private:
+	std::vector<Cell> values;
+};
+
+#endif //PIET_STACK_H
@@ -0,0 +1,58 @@
+#include "vm.h"
+
+#include "handlers.h"
+
+template<typename Cell>
+void next_state(const Program& program, VM<Cell>& vm) {
+	const unsigned exit = vm.dp * 2 + vm.cc;
+	const Opcode opcode = program.opcode(vm.block, exit);
+	
+	if(opcode == BLOCKED) {
+		// Bumped into black block or fell off the edge
+		if(vm.swapped) {
+			vm.dp = (vm.dp + 1) % 4;
+			vm.turned++;
+		} else {
+			vm.cc = (vm.cc + 1) % 2;
+			vm.swapped = !vm.swapped;
+		}
+	} else {
+		// Perform operation associated with the color transition
+		count(vm, opcode != SKIP);
+		
+		commands<Cell>[opcode](vm, program.block_size(vm.block));
+		vm.block = program.successor(vm.block, exit);
+		
+		vm.turned = 0;
+		vm.swapped = false;
+	}
+}
+
+bool resolve(const Program& program, unsigned block, short& dp, short& cc) {
+	for(int attempt = 0; attempt < 5; attempt++) {
+		if(program.opcode(block, dp * 2 + cc) != BLOCKED) return true;
+		
+		if(attempt == 0) {
+			cc = (cc + 1) % 2;
+		} else {
+			dp = (dp + 1) % 4;
+		}
+	}
+	
+	return false;
+}
+
+template<typename Cell>
+void run(const Program& program, VM<Cell>& vm) {
+	if(program.color(vm.block) != BLACK) {
+		while(vm.turned < 4) {
+			next_state(program, vm);
+		}
+	}
+}
+
+#define INSTANTIATE(Cell) \
+	template void next_state(const Program& program, VM<Cell>& vm); \
+	template void run(const Program& program, VM<Cell>& vm);
+
+PIET_CELLS(INSTANTIATE)
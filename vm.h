@@ -0,0 +1,46 @@
+#ifndef PIET_VM_H
+#define PIET_VM_H
+
+#include "program.h"
+#include "stack.h"
+
+#include <cstdint>
+#include <iostream>
+
+// Everything that changes while a Program runs. Stepping only moves an index around, so it never copies a Block
+template<typename Cell>
+struct VM {
+	unsigned block = 0;
+	Stack<Cell> stack;
+	short dp = 0;    // 0 is right, 1 is down, 2 is left, 3 is up
+	short cc = 0;    // 0 is left, 1 is right
+	short turned = 0;
+	bool swapped = false;
+	std::uint64_t steps = 0;    // Commands executed, only counted with checked cells to say where an overflow happened
+	std::istream* in = &std::cin;
+	std::ostream* out = &std::cout;
+};
+
+// Checked cells count the commands executed so an overflow can say where it happened, for everything else this compiles to nothing
+template<typename Cell>
+inline void count(VM<Cell>& vm, unsigned commands) {
+	if(is_checked<Cell>::value) {
+		vm.steps += commands;
+	}
+}
+
+// The operand is the size of the block being left, which is only used by push
+template<typename Cell>
+using command = void (*)(VM<Cell>&, std::uint32_t operand);
+
+template<typename Cell>
+void next_state(const Program& program, VM<Cell>& vm);
+
+// Applies the retry protocol of next_state to a block that was just entered, returns false if every attempt is blocked
+bool resolve(const Program& program, unsigned block, short& dp, short& cc);
+
+// Runs until the program terminates
+template<typename Cell>
+void run(const Program& program, VM<Cell>& vm);
+
+#endif //PIET_VM_H